@@ -21,6 +21,12 @@
 
 /* Includes ------------------------------------------------------------------*/
 /* Standard includes. */
+/* pthread_setaffinity_np, CPU_SET: build에서 -D_GNU_SOURCE (.vscode/tasks.json).
+   em2.c 보다 먼저 system header가 include 되어 있으면 여기서 define 해도 효과 없음 */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -28,9 +34,16 @@
 #include "em2.h"
 
 /* scheduler includes */
-#ifndef PC_SIMULATION
+#ifdef PC_SIMULATION
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#else
 #include "FreeRTOS.h"
 #include "task.h"
+#include "queue.h"
 #endif
 
 /* driver includes */
@@ -39,20 +52,156 @@
 #include "debugprint.h"
 #endif
 /* Private typedef -----------------------------------------------------------*/
+/* dispatch 중 사용하는 변수들 (stack 대신 context 별 static 영역 사용) */
+typedef struct
+{
+    em_event_arg_type       trigger_event;
+    uint8_t                 *event_msg_backup;
+    em_event_arg_type       *current_event;
+    em_event_group_type     *group;
+    em_handler_list_type    *gListHandler;
+    em_event_id_type        *evt_handler;
+    em_handler_list_type    *eListHandler;
+} em_dispatch_ctx_type;
+
+typedef struct
+{
+    int16_t                 group_index;    /* < 0 : dispatcher stop request */
+    int16_t                 signal;
+    uint16_t                hasarg;
+    uint16_t                ownsmsg;        /* 1: handler 수행 후 arg.msg free */
+    em_handler_list_type    *node;          /* NULL: group 전체 dispatch, 그 외: offload 된 handler만 수행 */
+    em_event_arg_type       arg;
+} em_queue_item_type;
+
+typedef struct
+{
+    #ifdef PC_SIMULATION
+    pthread_mutex_t         lock;
+    pthread_cond_t          cond;
+    em_queue_item_type      item[EM_SHARD_QUEUE_DEPTH];
+    uint16_t                head;
+    uint16_t                tail;
+    uint16_t                count;
+    int                     evfd;           /* host lane eventfd, 그 외 -1 */
+    uint8_t                 signalled;      /* evfd에 write 후 drain 전 */
+    #else
+    QueueHandle_t           handle;
+    #endif
+    uint32_t                heap_bytes;     /* 대기 item이 가지고 있는 heap msg (em_memory_report), queue 별 */
+} em_queue_type;
+
+typedef struct
+{
+    em_queue_type           queue;
+    em_dispatch_ctx_type    ctx;
+    int16_t                 cpu;
+    uint32_t                users;          /* 이 lane counter로 queue 사용 중인 post 수 (em_shard_enter) */
+    #ifdef PC_SIMULATION
+    pthread_t               thread;
+    #else
+    TaskHandle_t            task;
+    #endif
+} em_shard_type;
+
+/* em_event_post_from_isr() ring slot (첫 member는 seq) */
+typedef struct
+{
+    uint32_t                seq;
+    int16_t                 group_index;
+    int16_t                 signal;
+    uint16_t                hasarg;
+    em_event_arg_type       arg;
+} em_isr_slot_type;
+
+/* EM_ARG_STORAGE_REFCOUNT buffer */
+typedef struct
+{
+    uint32_t                refcnt;
+    uint16_t                len;
+    uint8_t                 data[];
+} em_payload_ref_type;
+
+/* 살아 있는 참조 count payload 통계 (payload 주소로 stripe 선택, stripe 마다 별도 cache line) */
+typedef struct
+{
+    uint32_t                cnt;
+    uint32_t                bytes;
+} __attribute__((aligned(64))) em_payload_stat_type;
+
 /* Private define ------------------------------------------------------------*/
+#define EM_EVT_HASH_INIT_SIZE   8
+#define EM_HANDLER_SET_INIT_SIZE    4
+#define EM_PAYLOAD_STAT_STRIPES     8   /* 2^n */
+
 /* Private macro -------------------------------------------------------------*/
+#define EM_PAYLOAD_REF(msg)     ((em_payload_ref_type *)((uint8_t *)(msg) - offsetof(em_payload_ref_type, data)))
+/* 같은 payload의 생성/free는 같은 stripe */
+#define EM_PAYLOAD_STAT(ref)    (&em_payload_stat[em_hash_index((uint32_t)((uintptr_t)(ref) >> 4), EM_PAYLOAD_STAT_STRIPES)])
+
+/* handler hash set key: mailbox subscriber는 mailbox, 그 외 handler */
+#define EM_HANDLER_KEY(node)    ((node)->mailbox ? (uintptr_t)(node)->mailbox : (uintptr_t)(node)->handler)
+
+/* EM_ARG_STORAGE_REFCOUNT 설정, data에 msg 복사본 (EM_ARG_IS_REFCOUNT 확인 값) */
+#define EM_ARG_SET_REFCOUNT(ev, ptr)                    \
+    {                                                   \
+        (ev)->storage = EM_ARG_STORAGE_REFCOUNT;        \
+        (ev)->msg = (ptr);                              \
+        memcpy((ev)->data, &(ev)->msg, sizeof(void *)); \
+    }
+
+/* inline payload는 복사 후 msg가 복사본의 data를 가리키도록 다시 설정 */
+#define EM_ARG_FIXUP(ev)                                \
+    if ((ev)->storage == EM_ARG_STORAGE_INLINE)         \
+    {                                                   \
+        (ev)->msg = (ev)->data;                         \
+    }
+
 /* Private variables ---------------------------------------------------------*/
 static em_event_group_list_type root_event_list;
-static em_event_arg_type trigger_event;
 
-uint8_t *event_msg_backup;
-em_event_arg_type *current_event;
-em_event_group_type *group;
-em_handler_list_type *gListHandler;
-em_event_id_type *evt_handler;
-em_handler_list_type *eListHandler;
+static em_shard_type em_shard[MAX_EM_SHARD_COUNT];
+static uint16_t em_shard_count;
+/* shard lifecycle (0: 정지, 1: 시작 중, 2: 동작 중, 3: 정지 중), 사용 중인 post 수는 em_shard[].users */
+static uint8_t em_shard_state;
+
+/* host event loop lane (thread 없음, em_dispatch_pending()에서 처리) */
+static em_shard_type em_host;
+static uint8_t em_host_ready;
+
+/* ISR post ring (producer: ISR/signal handler, consumer: em_dispatch_isr_events() 호출 task 1개) */
+static em_isr_slot_type em_isr_slot[EM_ISR_RING_DEPTH];
+static uint32_t em_isr_head;
+static uint32_t em_isr_tail;
+static uint32_t em_isr_drop_cnt;
+static uint8_t em_isr_signalled;
+static em_dispatch_ctx_type em_isr_ctx;
+#ifndef PC_SIMULATION
+static TaskHandle_t em_isr_notify_task;
+#endif
+
+/* slow handler executor lane (0: 없음, 1: 생성 중, 2: 동작 중, 3: 정지 중) */
+static em_shard_type em_executor;
+static uint8_t em_executor_state;
+static uint32_t em_executor_users;
+static em_slow_handler_fp em_slow_handler_cb;
+
+/* 살아 있는 참조 count payload (em_memory_report 에서 합산) */
+static em_payload_stat_type em_payload_stat[EM_PAYLOAD_STAT_STRIPES];
+
+/* 교체 된 fan-out: dispatcher가 읽고 있을 수 있으므로 fanout_readers 0 일 때 free (em_fanout_reclaim) */
+static em_fanout_type *em_fanout_retired;
+static uint32_t em_fanout_retired_bytes;
+
+/* em_compact() arena: event entry, handler node를 dispatch 순서로 저장 */
+static uint8_t *em_arena;
+static uint32_t em_arena_size;
 
 /* Private function prototypes -----------------------------------------------*/
+static int em_offload_handler(em_handler_list_type *node, int16_t group_index, int16_t signal,
+                              em_event_arg_type *event, int16_t transfer);
+static int em_mailbox_post(em_mailbox_type *mailbox, const char *groupname, int16_t signal, em_event_arg_type *event);
+static em_handler_list_type *em_handler_set_find(em_handler_index_type *index, uintptr_t key);
 /* Private function code -----------------------------------------------------*/
 /**
   * @brief  em_default_handler
@@ -68,9 +217,8 @@ void em_default_handler(const char *groupname, int16_t signal, em_event_arg_type
     DEBUGHI(GEN,"Default Handler: Event group(%s) event(0x%04x) arg(%p) triggered!\n", groupname, signal, ev);
     #endif
 
-    #if (DEFAULT_HANDLER_NO_MEM_FREE < 0)
+    /* default_handler_free = 0 인 group은 isconst = 1 로 전달 됨 */
     EM_IS_MEMFREEREQUIRED(ev);
-    #endif
 }
 
 /**
@@ -124,9 +272,15 @@ em_handler_list_type *createNode(evt_handler_fp handler)
     #else
     em_handler_list_type *newNode = (em_handler_list_type *)pvPortMalloc(sizeof(em_handler_list_type));
     #endif 
+    if(newNode == NULL) {
+        return NULL;
+    }
 
+    memset(newNode, 0x00, sizeof(em_handler_list_type));
     newNode->handler = handler;
     newNode->pNext = NULL; // 생성할 때는 next를 NULL로 초기화
+    newNode->budget_us = EM_DEFAULT_HANDLER_BUDGET_US;
+    newNode->sub_cnt = 1;
 
     return newNode;   
 }
@@ -190,59 +344,173 @@ int getHandlerCount(em_handler_list_type *handler)
     return count;
 }
 
+/**
+  * @brief  em_hash_index
+  * @note   Fibonacci hashing: 곱의 상위 bit 사용 (하위 bit만 다른 key도 분산, 0x0100 단위 enum, 정렬 된 pointer)
+  * @param  size: table 크기 (2^n)
+  * @retval home slot
+  */
+static uint16_t em_hash_index(uint32_t key, uint16_t size)
+{
+    if(size <= 1) {
+        return 0;
+    }
+    return (uint16_t)((key * 2654435769u) >> (32 - __builtin_ctz(size)));
+}
+
+/**
+  * @brief  em_evt_hash_slot
+  * @note   EM_LOOKUP_HASH group의 hash index slot (open addressing, linear probing)
+  * @param  None
+  * @retval event가 있는 slot 또는 비어 있는 slot
+  */
+static em_event_id_type **em_evt_hash_slot(em_event_id_type **table, uint16_t size, int16_t event)
+{
+    uint16_t i = em_hash_index((uint16_t)event, size);
+
+    while((table[i] != NULL) && (table[i]->event != event)) {
+        i = (i + 1) & (size - 1);
+    }
+    return &table[i];
+}
+
+/**
+  * @brief  em_evt_hash_insert
+  * @note   load factor 1/2 초과 시 2배로 rehash
+  * @param  None
+  * @retval 0: success, -1: error
+  */
+static int em_evt_hash_insert(em_event_group_type *group, em_event_id_type *evt)
+{
+    if((group->group_evt_cnt + 1) * 2 > group->evt_hash_size) {
+        uint16_t size = group->evt_hash_size ? group->evt_hash_size * 2 : EM_EVT_HASH_INIT_SIZE;
+        #ifdef PC_SIMULATION
+        em_event_id_type **table = (em_event_id_type **)malloc(sizeof(em_event_id_type *) * size);
+        #else
+        em_event_id_type **table = (em_event_id_type **)pvPortMalloc(sizeof(em_event_id_type *) * size);
+        #endif 
+        if(table == NULL) {
+            return -1;
+        }
+        memset(table, 0x00, sizeof(em_event_id_type *) * size);
+        for(uint16_t i = 0; i < group->evt_hash_size; i++) {
+            if(group->evt_hash[i]) {
+                *em_evt_hash_slot(table, size, group->evt_hash[i]->event) = group->evt_hash[i];
+            }
+        }
+        if(group->evt_hash) {
+            #ifdef PC_SIMULATION
+            free(group->evt_hash);
+            #else
+            vPortFree(group->evt_hash);
+            #endif 
+        }
+        group->evt_hash = table;
+        group->evt_hash_size = size;
+    }
+    *em_evt_hash_slot(group->evt_hash, group->evt_hash_size, evt->event) = evt;
+    return 0;
+}
+
 /**
   * @brief  getEventHandler
-  * @note   
+  * @note   EM_LOOKUP_DENSE: array index, EM_LOOKUP_HASH: hash index
   * @param  None
   * @retval None
   */
 em_event_id_type *getEventHandler(em_event_group_type *group, int16_t event)
 {
-    em_event_group_type *ghan = group;
-    em_event_id_type *idhand = group->evthandler;
-
-    #if (FEATURE_SEQUENCE_EVENT_ENUM > 0)
-    return &idhand[event];
-    #else
-    for(int i=0;i<ghan->group_evt_cnt;i++) {
-        if(idhand->event == event) {
-            return idhand;
-        }
-        else {
-            idhand = idhand->pNext;
+    if(group->attr.lookup == EM_LOOKUP_DENSE) {
+        if((event < 0) || (event >= group->group_evt_cnt)) {
+            return NULL;
         }
+        return &group->evthandler[event];
     }
-    #endif
-    return NULL;
+
+    if(group->evt_hash == NULL) {
+        return NULL;
+    }
+    return *em_evt_hash_slot(group->evt_hash, group->evt_hash_size, event);
 }
 
 /**
-  * @brief  is_event_backup_require
-  * @note   하나의 signal에 여러개의 handler가 등록 되어 있는경우
+  * @brief  em_fanout_acquire
+  * @note   group fan-out array 읽기 시작. NULL이 아니면 em_fanout_release() 필요
+  *         fanout_readers가 0이 될 때 까지 교체 된 array는 free 하지 않음
+  * @param  None
+  * @retval fan-out array, NULL: 없음
+  */
+static em_fanout_type *em_fanout_acquire(em_event_group_type *group)
+{
+    em_fanout_type *fanout;
+
+    /* fan-out 없는 group은 counter 사용 안함 */
+    if(__atomic_load_n(&group->fanout, __ATOMIC_RELAXED) == NULL) {
+        return NULL;
+    }
+    __atomic_add_fetch(&group->fanout_readers, 1, __ATOMIC_SEQ_CST);
+    fanout = __atomic_load_n(&group->fanout, __ATOMIC_SEQ_CST);
+    if(fanout == NULL) {
+        __atomic_sub_fetch(&group->fanout_readers, 1, __ATOMIC_RELEASE);
+    }
+    return fanout;
+}
+
+/**
+  * @brief  em_fanout_release
+  * @note   
   * @param  None
   * @retval None
   */
-int is_event_backup_require(int16_t group_index, em_event_arg_type *event, int16_t signal)
+static void em_fanout_release(em_event_group_type *group)
+{
+    __atomic_sub_fetch(&group->fanout_readers, 1, __ATOMIC_RELEASE);
+}
+
+/**
+  * @brief  em_fanout_is_subscribed
+  * @note   parent fan-out handler가 event 자신의 handler list에도 있는지 (event당 1번만 호출, event handler로 호출)
+  * @param  None
+  * @retval 1: event handler list에 있음 (fan-out 에서 건너뜀)
+  */
+static int em_fanout_is_subscribed(em_event_id_type *evt, em_handler_list_type *node)
 {
+    return (evt != NULL) && (em_handler_set_find(&evt->index, EM_HANDLER_KEY(node)) != NULL);
+}
 
-    #if (HANDLER_REQUIRED_MEMORYFREE > 0)
+/**
+  * @brief  is_event_backup_require
+  * @note   하나의 signal에 여러개의 handler가 등록 되어 있는경우 (EM_PAYLOAD_COPY group)
+  * @param  None
+  * @retval None
+  */
+int is_event_backup_require(int16_t group_index, em_event_arg_type *event, int16_t signal, em_fanout_type *fanout)
+{
     int count;
+    em_event_group_type *group = &root_event_list.group[group_index];
 
+    if(group->attr.payload != EM_PAYLOAD_COPY) {
+        return -1;
+    }
     if ((event == NULL) || (event->msg == NULL) || (event->isconst == 1)) {
         return -1;
     }
-    em_event_group_type *group = &root_event_list.group[group_index];
     em_handler_list_type *handler = group->grphandler;
     
     /* default handler */
-    #if (DEFAULT_HANDLER_NO_MEM_FREE > 0)
-    if(handler) {
+    if(handler && !group->attr.default_handler_free) {
         handler = handler->pNext;
     }
-    #endif
     count = getHandlerCount(handler);
-    
+
+    /* parent group handler */
     em_event_id_type *evt_handler = getEventHandler(group, signal);
+    for(uint16_t i = 0; fanout && (i < fanout->cnt); i++) {
+        if(fanout->node[i]->handler && !em_fanout_is_subscribed(evt_handler, fanout->node[i])) {
+            count++;
+        }
+    }
+    
     if(evt_handler) {
         count += getHandlerCount(evt_handler->handler);
     }
@@ -250,38 +518,145 @@ int is_event_backup_require(int16_t group_index, em_event_arg_type *event, int16
     if(count > 0) {
         return count;
     }
-    #endif
     return -1;
 }
 
 
 /**
   * @brief  addToTailHandlerList
-  * @note   
+  * @note   tail pointer로 list walk 없이 추가
   * @param  None
   * @retval None
   */
-void addToTailHandlerList(em_handler_list_type **head, em_handler_list_type *node)
+void addToTailHandlerList(em_handler_list_type **head, em_handler_list_type **tail, em_handler_list_type *node)
 {
-    em_handler_list_type *temp = *head;
-    if(temp) {
-        do {
-            if(temp->pNext == NULL) {
-                temp->pNext = node;
-                temp = temp->pNext;
-            }
-            temp = temp->pNext;
-        } while (temp != NULL);
+    node->pNext = NULL;
+    if(*head) {
+        (*tail)->pNext = node;
     }
     else {
         *head = node;
     }
+    *tail = node;
 }
 
-#if (FEATURE_SEQUENCE_EVENT_ENUM <= 0)
+/**
+  * @brief  em_handler_set_slot
+  * @note   handler hash set slot (open addressing, linear probing)
+  * @param  None
+  * @retval key가 있는 slot 또는 비어 있는 slot
+  */
+static em_handler_list_type **em_handler_set_slot(em_handler_list_type **set, uint16_t size, uintptr_t key)
+{
+    uint16_t i = em_hash_index((uint32_t)((uint64_t)key ^ ((uint64_t)key >> 32)), size);
+
+    while((set[i] != NULL) && (EM_HANDLER_KEY(set[i]) != key)) {
+        i = (i + 1) & (size - 1);
+    }
+    return &set[i];
+}
 
 /**
-  * @brief  addToTailHandlerList
+  * @brief  em_handler_set_insert
+  * @note   load factor 1/2 초과 시 2배로 rehash
+  * @param  None
+  * @retval 0: success, -1: error
+  */
+static int em_handler_set_insert(em_handler_index_type *index, em_handler_list_type *node)
+{
+    if((index->cnt + 1) * 2 > index->set_size) {
+        uint16_t size = index->set_size ? index->set_size * 2 : EM_HANDLER_SET_INIT_SIZE;
+        #ifdef PC_SIMULATION
+        em_handler_list_type **set = (em_handler_list_type **)malloc(sizeof(em_handler_list_type *) * size);
+        #else
+        em_handler_list_type **set = (em_handler_list_type **)pvPortMalloc(sizeof(em_handler_list_type *) * size);
+        #endif 
+        if(set == NULL) {
+            return -1;
+        }
+        memset(set, 0x00, sizeof(em_handler_list_type *) * size);
+        for(uint16_t i = 0; i < index->set_size; i++) {
+            if(index->set[i]) {
+                *em_handler_set_slot(set, size, EM_HANDLER_KEY(index->set[i])) = index->set[i];
+            }
+        }
+        if(index->set) {
+            #ifdef PC_SIMULATION
+            free(index->set);
+            #else
+            vPortFree(index->set);
+            #endif 
+        }
+        index->set = set;
+        index->set_size = size;
+    }
+    *em_handler_set_slot(index->set, index->set_size, EM_HANDLER_KEY(node)) = node;
+    return 0;
+}
+
+/**
+  * @brief  em_handler_set_find
+  * @note   
+  * @param  None
+  * @retval NULL: 없음
+  */
+static em_handler_list_type *em_handler_set_find(em_handler_index_type *index, uintptr_t key)
+{
+    if(index->set == NULL) {
+        return NULL;
+    }
+    return *em_handler_set_slot(index->set, index->set_size, key);
+}
+
+/**
+  * @brief  em_handler_list_add
+  * @note   중복(같은 handler 또는 mailbox)은 추가 하지 않음.
+  *         EM_SUBSCRIBE_REFCOUNT 이면 기존 node의 sub_cnt 증가
+  * @param  None
+  * @retval 0: 추가, 1: 중복 (node 사용 안함), -1: memory allocation error
+  */
+static int em_handler_list_add(em_handler_list_type **head, em_handler_index_type *index, em_handler_list_type *node, uint16_t flags)
+{
+    em_handler_list_type *dup = em_handler_set_find(index, EM_HANDLER_KEY(node));
+
+    if(dup != NULL) {
+        if(flags & EM_SUBSCRIBE_REFCOUNT) {
+            dup->sub_cnt++;
+        }
+        return 1;
+    }
+    if(em_handler_set_insert(index, node) < 0) {
+        return -1;
+    }
+    addToTailHandlerList(head, &index->tail, node);
+    index->cnt++;
+    return 0;
+}
+
+/**
+  * @brief  em_handler_index_rebuild
+  * @note   node 위치가 바뀐 list (em_compact) 의 tail, hash set 다시 구성. set size 변화 없음
+  * @param  None
+  * @retval None
+  */
+static void em_handler_index_rebuild(em_handler_index_type *index, em_handler_list_type *head)
+{
+    if(index->set) {
+        memset(index->set, 0x00, sizeof(em_handler_list_type *) * index->set_size);
+    }
+    index->tail = NULL;
+    index->cnt = 0;
+    for(em_handler_list_type *node = head; node != NULL; node = node->pNext) {
+        if(index->set) {
+            *em_handler_set_slot(index->set, index->set_size, EM_HANDLER_KEY(node)) = node;
+        }
+        index->tail = node;
+        index->cnt++;
+    }
+}
+
+/**
+  * @brief  addToTailEventList
   * @note   
   * @param  None
   * @retval None
@@ -302,252 +677,2667 @@ void addToTailEventList(em_event_id_type **head, em_event_id_type *node)
         *head = node;
     }
 }
-#endif
 
-/* Global function code ------------------------------------------------------*/
+/**
+  * @brief  em_arg_normalize
+  * @note   호출자 argument의 storage 확인. em_event_arg_set()으로 만들지 않은 argument는 HEAP
+  *         (초기화 안된 storage 값 무시). public 함수 진입 시 1번 수행
+  * @param  None
+  * @retval None
+  */
+static void em_arg_normalize(em_event_arg_type *event)
+{
+    if((event != NULL) && !EM_ARG_IS_INLINE(event) && !EM_ARG_IS_REFCOUNT(event)) {
+        event->storage = EM_ARG_STORAGE_HEAP;
+    }
+}
 
 /**
-  * @brief  em_on_event
-  * @note   Event request
+  * @brief  em_payload_ref_new
+  * @note   EM_ARG_STORAGE_REFCOUNT buffer 생성 (refcnt = 1)
+  * @param  None
+  * @retval NULL: memory allocation error
+  */
+static em_payload_ref_type *em_payload_ref_new(const void *msg, uint16_t len)
+{
+    #ifdef PC_SIMULATION
+    em_payload_ref_type *ref = (em_payload_ref_type *)malloc(sizeof(em_payload_ref_type) + len + 1);
+    #else
+    em_payload_ref_type *ref = (em_payload_ref_type *)pvPortMalloc(sizeof(em_payload_ref_type) + len + 1);
+    #endif 
+    if(ref == NULL) {
+        #ifdef PC_SIMULATION
+        printf("Memory allocation error\n");
+        #else
+        DEBUGERR(GEN, AllocErrMsg("em_payload_ref_new"));
+        #endif  
+        return NULL;
+    }
+    ref->refcnt = 1;
+    ref->len = len;
+    memcpy(ref->data, msg, len);
+    ref->data[len] = 0x00;
+
+    em_payload_stat_type *stat = EM_PAYLOAD_STAT(ref);
+    __atomic_add_fetch(&stat->cnt, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&stat->bytes, sizeof(em_payload_ref_type) + len + 1, __ATOMIC_RELAXED);
+    return ref;
+}
+
+/**
+  * @brief  em_payload_ref_put
+  * @note   참조 count 감소, 0 이면 free
   * @param  None
   * @retval None
   */
-void em_on_event(em_group_name_type *eventgroup, int16_t signal, evt_handler_fp handler)
+static void em_payload_ref_put(em_payload_ref_type *ref)
 {
-    em_handler_list_type *new_node;
-    em_event_group_type *group;
-    em_event_id_type *evt_handler;
+    em_payload_stat_type *stat;
 
-    if( eventgroup->name && handler ) {
-        /* 등록된 그룹인지 확인 한다. */
-        em_event_group_type *group = get_registered_group(eventgroup);
-        if( group != NULL ) {
-            new_node = createNode(handler);
+    if(__atomic_sub_fetch(&ref->refcnt, 1, __ATOMIC_ACQ_REL) == 0) {
+        stat = EM_PAYLOAD_STAT(ref);
+        __atomic_sub_fetch(&stat->cnt, 1, __ATOMIC_RELAXED);
+        __atomic_sub_fetch(&stat->bytes, sizeof(em_payload_ref_type) + ref->len + 1, __ATOMIC_RELAXED);
+        #ifdef PC_SIMULATION
+        free(ref);
+        #else
+        vPortFree(ref);
+        #endif 
+    }
+}
 
-            /* GROUP의 모든 EVENT에 대해 통보*/
-            if(signal < 0) {
-                addToTailHandlerList(&group->grphandler, new_node);
-            }
-            /* single event에 대한 통보 */
-            else {
-                evt_handler = getEventHandler(group, signal);
-                if(evt_handler) {
-                    evt_handler->event = signal;
-                    addToTailHandlerList(&evt_handler->handler, new_node);
-                }
-            }            
-            #ifdef PC_SIMULATION
-            printf("Event group(%s) Event(0x%04x) is requested!!!\n", eventgroup->name, signal);
-            #else
-            DEBUGMED(GEN,"Event group(%s) Event(0x%04x) is requested!!!\n", eventgroup->name, signal);
-            #endif         
-        }
-        else {
-            /* group 등록이 되어 있지 않음 */
-            #ifdef PC_SIMULATION
-            printf("Event group(%s) not registered!!!\n", eventgroup->name);
-            #else
-            DEBUGMED(GEN,"Event group(%s)not registered!!!\n", eventgroup->name);
-            #endif             
-        }
+/**
+  * @brief  em_payload_drop
+  * @note   event manager가 소유한 payload 정리 (isconst 무시)
+  * @param  None
+  * @retval None
+  */
+static void em_payload_drop(em_event_arg_type *event)
+{
+    if((event->msg == NULL) || (event->storage == EM_ARG_STORAGE_INLINE)) {
+        return;
+    }
+    if(event->storage == EM_ARG_STORAGE_REFCOUNT) {
+        em_payload_ref_put(EM_PAYLOAD_REF(event->msg));
     }
     else {
         #ifdef PC_SIMULATION
-        printf("Group, Handler must be defined!!!\n");
+        free(event->msg);
         #else
-        DEBUGMED(GEN,"Group, Handler must be defined!!!\n");
-        #endif   
+        vPortFree(event->msg);
+        #endif 
     }
+    event->msg = NULL;
 }
 
 /**
-  * @brief  em_events_register
-  * @note   Event register
+  * @brief  em_payload_prepare
+  * @note   group payload 정책에 맞게 ctx->current_event 준비
+  *         EM_PAYLOAD_COPY    : REFCOUNT argument는 heap 복사본으로 변경
+  *         EM_PAYLOAD_BORROW  : handler에는 isconst = 1 로 전달
+  *         EM_PAYLOAD_REFCOUNT: 참조 count buffer로 변경 (caller buffer는 free), isconst = 1 로 전달
+  *         EM_ARG_STORAGE_INLINE argument는 정책과 관계 없이 isconst = 1 로 그대로 전달
   * @param  None
   * @retval None
   */
-#if (FEATURE_SEQUENCE_EVENT_ENUM > 0)
-void em_events_register(em_group_name_type *eventgroup, int16_t event_count)
-#else
-void em_events_register(em_group_name_type *eventgroup, int16_t enum_event)
-#endif
+static void em_payload_prepare(em_dispatch_ctx_type *ctx, em_event_group_type *group, em_event_arg_type *event)
 {
-    uint16_t grp_cnt = root_event_list.group_cnt;
-
-    if( eventgroup->name ) {
-        /*새로운 GROUP인지, 이미 등록된 그룹인지 */
-        em_event_group_type *group = get_registered_group(eventgroup);
-        if( group == NULL ) {
-            group = &root_event_list.group[grp_cnt];
-
-            group->event_group.name = eventgroup->name;
-            group->event_group.gid = grp_cnt;
+    em_event_arg_type *cur = ctx->current_event;
+    em_payload_ref_type *ref;
 
-            eventgroup->gid = grp_cnt;
+    if(cur->storage == EM_ARG_STORAGE_INLINE) {
+        /* 값으로 전달, 모든 정책에서 free 필요 없음 */
+        cur->isconst = 1;
+        return;
+    }
 
-            /* Add Group Handler */
-            em_handler_list_type *gHandler = createNode(em_default_handler);
-            group->grphandler = gHandler;
+    switch(group->attr.payload) {
+    case EM_PAYLOAD_COPY:
+        if((cur->storage == EM_ARG_STORAGE_REFCOUNT) && (cur->msg != NULL)) {
+            ref = EM_PAYLOAD_REF(cur->msg);
+            cur->storage = EM_ARG_STORAGE_HEAP;
+            cur->isconst = 0;
+            cur->msg = em_NewEventMem(cur);
+            em_payload_ref_put(ref);
+            event->msg = NULL;
+        }
+        break;
 
-            /* Add event andler */
-            #if (FEATURE_SEQUENCE_EVENT_ENUM > 0)
-                #ifdef PC_SIMULATION
-                em_event_id_type *evhandle = (em_event_id_type *)malloc(sizeof(em_event_id_type)*event_count);
+    case EM_PAYLOAD_REFCOUNT:
+        if((cur->storage != EM_ARG_STORAGE_REFCOUNT) && (cur->msg != NULL)) {
+            ref = em_payload_ref_new(cur->msg, cur->len);
+            EM_IS_MEMFREEREQUIRED(event);
+            if(ref) {
+                EM_ARG_SET_REFCOUNT(cur, ref->data);
+            }
+            else {
+                cur->msg = NULL;
+            }
+        }
+        cur->isconst = 1;
+        break;
+
+    default:
+        /* memory free 는 event manager에서 수행 됨 */
+        cur->isconst = 1;
+        break;
+    }
+}
+
+/**
+  * @brief  em_payload_finish
+  * @note   dispatch 완료 후 event manager가 가진 payload 정리
+  * @param  None
+  * @retval None
+  */
+static void em_payload_finish(em_dispatch_ctx_type *ctx, em_event_group_type *group, em_event_arg_type *event)
+{
+    if(event == NULL) {
+        return;
+    }
+    switch(group->attr.payload) {
+    case EM_PAYLOAD_COPY:
+        /* handler에서 free */
+        break;
+
+    case EM_PAYLOAD_REFCOUNT:
+        if((ctx->current_event->storage == EM_ARG_STORAGE_REFCOUNT) && (ctx->current_event->msg != NULL)) {
+            em_payload_ref_put(EM_PAYLOAD_REF(ctx->current_event->msg));
+        }
+        /* 호출자의 참조 count buffer만 소유권이 넘어옴.
+           heap buffer는 em_payload_prepare()에서 free, const buffer는 호출자 소유 */
+        if(event->storage == EM_ARG_STORAGE_REFCOUNT) {
+            event->msg = NULL;
+        }
+        break;
+
+    default:
+        if((event->storage == EM_ARG_STORAGE_REFCOUNT) && (event->msg != NULL)) {
+            em_payload_ref_put(EM_PAYLOAD_REF(event->msg));
+            event->msg = NULL;
+        }
+        EM_IS_MEMFREEREQUIRED(event);
+        break;
+    }
+}
+
+/**
+  * @brief  em_last_value_update
+  * @note   seqlock writer. writer 끼리는 seq 짝수->홀수 CAS로 배타 처리
+  *         max_len 보다 큰 payload는 잘라서 저장
+  * @param  None
+  * @retval None
+  */
+static void em_last_value_update(em_last_value_type *last, em_event_arg_type *event)
+{
+    uint32_t seq = __atomic_load_n(&last->seq, __ATOMIC_RELAXED);
+
+    do {
+        while(seq & 1) {
+            seq = __atomic_load_n(&last->seq, __ATOMIC_RELAXED);
+        }
+    } while(!__atomic_compare_exchange_n(&last->seq, &seq, seq + 1, 1, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED));
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    if((event != NULL) && (event->msg != NULL)) {
+        last->len = (event->len < last->size) ? event->len : last->size;
+        memcpy(last->data, event->msg, last->len);
+        last->hasarg = 1;
+    }
+    else {
+        last->len = 0;
+        last->hasarg = (event != NULL) ? 1 : 0;
+    }
+    last->valid = 1;
+
+    __atomic_store_n(&last->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+/**
+  * @brief  em_last_value_read
+  * @note   seqlock reader. lock 없이 읽고 update와 겹치면 retry
+  * @param  None
+  * @retval 0: success, -1: cache 된 값 없음 또는 update 중
+  */
+static int em_last_value_read(em_last_value_type *last, void *buf, uint16_t buf_len, uint16_t *len, uint16_t *hasarg)
+{
+    uint32_t seq1, seq2;
+    uint16_t copy_len, valid, arg;
+
+    for(int retry = 0; retry < EM_LAST_VALUE_READ_RETRY; retry++) {
+        seq1 = __atomic_load_n(&last->seq, __ATOMIC_ACQUIRE);
+        if(seq1 & 1) {
+            continue;
+        }
+        valid = last->valid;
+        arg = last->hasarg;
+        copy_len = (last->len < buf_len) ? last->len : buf_len;
+        if(buf && copy_len) {
+            memcpy(buf, last->data, copy_len);
+        }
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        seq2 = __atomic_load_n(&last->seq, __ATOMIC_RELAXED);
+
+        if(seq1 == seq2) {
+            if(!valid) {
+                return -1;
+            }
+            if(len) {
+                *len = copy_len;
+            }
+            if(hasarg) {
+                *hasarg = arg;
+            }
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/**
+  * @brief  em_deliver_last_value
+  * @note   sticky subscribe: cache 된 값을 handler로 바로 전달 (호출한 task context)
+  *         memory free 정책은 em_event_trigger()와 동일
+  * @param  None
+  * @retval None
+  */
+static void em_deliver_last_value(em_event_group_type *group, em_event_id_type *evt, evt_handler_fp handler)
+{
+    em_event_arg_type arg;
+    uint16_t len = 0, hasarg = 0;
+    uint8_t *buf;
+
+    if((evt == NULL) || (evt->last == NULL)) {
+        return;
+    }
+
+    memset(&arg, 0x00, sizeof(em_event_arg_type));
+    if(evt->last->size < EM_INLINE_PAYLOAD_SIZE) {
+        /* heap 사용 안함 */
+        buf = arg.data;
+        arg.storage = EM_ARG_STORAGE_INLINE;
+    }
+    else {
+        #ifdef PC_SIMULATION
+        buf = malloc(evt->last->size + 1);
+        #else
+        buf = pvPortMalloc(evt->last->size + 1);
+        #endif
+        if(buf == NULL) {
+            return;
+        }
+        arg.storage = EM_ARG_STORAGE_HEAP;
+    }
+
+    if(em_last_value_read(evt->last, buf, evt->last->size, &len, &hasarg) == 0) {
+        buf[len] = 0x00;
+        arg.len = len;
+        arg.msg = len ? buf : NULL;
+        arg.isconst = ((group->attr.payload == EM_PAYLOAD_COPY) && (arg.storage == EM_ARG_STORAGE_HEAP)) ? 0 : 1;
+        handler(group->event_group.name, evt->event, hasarg ? &arg : NULL);
+        if(!arg.isconst && hasarg && len) {
+            /* handler가 free 함 */
+            buf = NULL;
+        }
+    }
+
+    if(arg.storage == EM_ARG_STORAGE_HEAP) {
+        #ifdef PC_SIMULATION
+        free(buf);
+        #else
+        vPortFree(buf);
+        #endif
+    }
+}
+
+/**
+  * @brief  em_timestamp_us
+  * @note   handler 실행 시간 측정용. target은 EM_TIMESTAMP_US() 정의 시 사용 (없으면 tick 단위)
+  * @param  None
+  * @retval usec
+  */
+static uint32_t em_timestamp_us(void)
+{
+    #if defined(EM_TIMESTAMP_US)
+    return EM_TIMESTAMP_US();
+    #elif defined(PC_SIMULATION)
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u);
+    #else
+    return (uint32_t)(xTaskGetTickCount() * portTICK_PERIOD_MS * 1000u);
+    #endif
+}
+
+/**
+  * @brief  em_handler_measure
+  * @note   budget 초과가 연속 EM_SLOW_HANDLER_OFFLOAD_COUNT 회 이면 executor lane으로 이동.
+  *         같은 handler가 shard thread와 trigger 호출 thread에서 동시에 측정 될 수 있으므로 atomic 사용
+  * @param  None
+  * @retval None
+  */
+static void em_handler_measure(em_handler_list_type *node, const char *groupname, int16_t signal, uint32_t elapsed_us)
+{
+    uint32_t max_us = __atomic_load_n(&node->max_us, __ATOMIC_RELAXED);
+    uint16_t expected = 0;
+
+    __atomic_add_fetch(&node->call_cnt, 1, __ATOMIC_RELAXED);
+    while((elapsed_us > max_us) &&
+          !__atomic_compare_exchange_n(&node->max_us, &max_us, elapsed_us, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+    if((node->budget_us == 0) || (elapsed_us <= node->budget_us)) {
+        __atomic_store_n(&node->overrun_seq, 0, __ATOMIC_RELAXED);
+        return;
+    }
+
+    __atomic_add_fetch(&node->overrun_cnt, 1, __ATOMIC_RELAXED);
+    if((__atomic_add_fetch(&node->overrun_seq, 1, __ATOMIC_RELAXED) >= EM_SLOW_HANDLER_OFFLOAD_COUNT) &&
+       __atomic_compare_exchange_n(&node->offloaded, &expected, 1, 0, __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+        if(em_slow_handler_cb) {
+            em_slow_handler_cb(groupname, signal, node->handler, elapsed_us);
+        }
+    }
+}
+
+/**
+  * @brief  em_invoke_handler
+  * @note   handler 1개 수행. isbackupreq > 0 이면 다음 handler용 msg 복사본 생성
+  *         offload 된 handler는 executor lane queue로 전달 (queue full 이면 drop, drop_cnt 증가)
+  * @param  None
+  * @retval None
+  */
+static void em_invoke_handler(em_dispatch_ctx_type *ctx, em_handler_list_type *node, int16_t group_index,
+                              const char *groupname, int16_t signal, int16_t isbackupreq)
+{
+    uint32_t start;
+
+    /* mailbox subscriber: 자체 복사본으로 전달 하므로 backup 필요 없음 */
+    if(node->mailbox != NULL) {
+        em_mailbox_post(node->mailbox, groupname, signal, ctx->current_event);
+        return;
+    }
+
+    if(isbackupreq > 0) {
+        ctx->event_msg_backup = em_NewEventMem(ctx->current_event);
+    }
+
+    if(__atomic_load_n(&node->offloaded, __ATOMIC_ACQUIRE)) {
+        /* offload 된 handler는 inline 으로 수행 하지 않음 (executor queue full 이면 drop) */
+        if(em_offload_handler(node, group_index, signal, ctx->current_event, isbackupreq) < 0) {
+            __atomic_add_fetch(&node->drop_cnt, 1, __ATOMIC_RELAXED);
+        }
+    }
+    else {
+        start = em_timestamp_us();
+        node->handler(groupname, signal, ctx->current_event);
+        em_handler_measure(node, groupname, signal, em_timestamp_us() - start);
+    }
+
+    if(ctx->event_msg_backup != NULL) {
+        ctx->current_event->msg = ctx->event_msg_backup;
+    }
+}
+
+/**
+  * @brief  em_group_is_descendant
+  * @note   group_index가 ancestor_index 자신 또는 하위 group 인지
+  * @param  None
+  * @retval 1: yes, 0: no
+  */
+static int em_group_is_descendant(int16_t group_index, int16_t ancestor_index)
+{
+    for(int depth = 0; (group_index >= 0) && (depth < MAX_ROOT_EVENT_GROUP_COUNT); depth++) {
+        if(group_index == ancestor_index) {
+            return 1;
+        }
+        group_index = root_event_list.group[group_index].parent;
+    }
+    return 0;
+}
+
+/**
+  * @brief  em_fanout_is_duplicate
+  * @note   group_index 의 parent 중 stop_index 보다 가까운 group(자신 포함)이 같은 handler를 이미 구독 했는지
+  * @param  None
+  * @retval 1: 이미 있음 (중복 호출 되므로 fan-out 에서 제외)
+  */
+static int em_fanout_is_duplicate(int16_t group_index, int16_t stop_index, em_handler_list_type *node)
+{
+    for(int depth = 0; (group_index >= 0) && (group_index != stop_index) && (depth < MAX_ROOT_EVENT_GROUP_COUNT); depth++) {
+        if(em_handler_set_find(&root_event_list.group[group_index].grpindex, EM_HANDLER_KEY(node)) != NULL) {
+            return 1;
+        }
+        group_index = root_event_list.group[group_index].parent;
+    }
+    return 0;
+}
+
+/**
+  * @brief  em_fanout_reclaim
+  * @note   retired array 중 소유 group을 읽는 dispatch가 없는 것을 free.
+  *         교체(SEQ_CST exchange) 후 fanout_readers 0 이면 이전 array를 가진 dispatch는 모두 끝난 것
+  * @param  None
+  * @retval None
+  */
+static void em_fanout_reclaim(void)
+{
+    em_fanout_type **link = &em_fanout_retired;
+    em_fanout_type *fanout;
+
+    while((fanout = *link) != NULL) {
+        if(__atomic_load_n(&root_event_list.group[fanout->group_index].fanout_readers, __ATOMIC_SEQ_CST) != 0) {
+            link = &fanout->retired_next;
+            continue;
+        }
+        *link = fanout->retired_next;
+        em_fanout_retired_bytes -= sizeof(em_fanout_type) + sizeof(em_handler_list_type *) * fanout->cnt;
+        #ifdef PC_SIMULATION
+        free(fanout);
+        #else
+        vPortFree(fanout);
+        #endif 
+    }
+}
+
+/**
+  * @brief  em_group_build_fanout
+  * @note   상위 group들의 group handler(default handler 제외)를 평탄화 해서 fan-out array로 저장.
+  *         trigger 시 tree를 올라가지 않도록 subscription/parent 변경 시에만 계산.
+  *         새 array는 atomic 으로 교체, 이전 array는 dispatcher가 읽고 있을 수 있으므로 retired list로
+  *         (해당 group fanout_readers가 0 일 때 em_fanout_reclaim() 에서 free)
+  * @param  None
+  * @retval 0: success, -1: memory allocation error
+  */
+static int em_group_build_fanout(em_event_group_type *group)
+{
+    em_fanout_type *fanout = NULL, *old;
+    em_handler_list_type *node;
+    uint16_t count = 0, n = 0;
+    int16_t self = (int16_t)group->event_group.gid;
+    int16_t p;
+    int depth;
+
+    for(p = group->parent, depth = 0; (p >= 0) && (depth < MAX_ROOT_EVENT_GROUP_COUNT); p = root_event_list.group[p].parent, depth++) {
+        node = root_event_list.group[p].grphandler;
+        /* 첫 node는 parent의 default handler -> 제외 */
+        for(node = node ? node->pNext : NULL; node != NULL; node = node->pNext) {
+            if(!em_fanout_is_duplicate(self, p, node)) {
+                count++;
+            }
+        }
+    }
+
+    if(count) {
+        #ifdef PC_SIMULATION
+        fanout = (em_fanout_type *)malloc(sizeof(em_fanout_type) + sizeof(em_handler_list_type *) * count);
+        #else
+        fanout = (em_fanout_type *)pvPortMalloc(sizeof(em_fanout_type) + sizeof(em_handler_list_type *) * count);
+        #endif 
+        if(fanout == NULL) {
+            return -1;
+        }
+        fanout->retired_next = NULL;
+        fanout->group_index = self;
+        for(p = group->parent, depth = 0; (p >= 0) && (depth < MAX_ROOT_EVENT_GROUP_COUNT); p = root_event_list.group[p].parent, depth++) {
+            node = root_event_list.group[p].grphandler;
+            for(node = node ? node->pNext : NULL; (node != NULL) && (n < count); node = node->pNext) {
+                if(!em_fanout_is_duplicate(self, p, node)) {
+                    fanout->node[n++] = node;
+                }
+            }
+        }
+        fanout->cnt = n;
+    }
+
+    old = __atomic_exchange_n(&group->fanout, fanout, __ATOMIC_SEQ_CST);
+    if(old) {
+        old->retired_next = em_fanout_retired;
+        em_fanout_retired = old;
+        em_fanout_retired_bytes += sizeof(em_fanout_type) + sizeof(em_handler_list_type *) * old->cnt;
+    }
+    em_fanout_reclaim();
+    return 0;
+}
+
+/**
+  * @brief  em_group_rebuild_fanout
+  * @note   group_index 와 그 하위 group 전체의 fan-out array 다시 계산
+  * @param  None
+  * @retval None
+  */
+static void em_group_rebuild_fanout(int16_t group_index)
+{
+    for(int16_t i = 0; i < root_event_list.group_cnt; i++) {
+        if(em_group_is_descendant(i, group_index)) {
+            em_group_build_fanout(&root_event_list.group[i]);
+        }
+    }
+}
+
+/**
+  * @brief  em_subscribe_node
+  * @note   signal < 0 이면 group handler list, 그 외 event handler list 끝에 추가.
+  *         group handler 추가 시 하위 group fan-out은 호출 하는 쪽에서 em_group_rebuild_fanout()
+  * @param  flags: EM_SUBSCRIBE_REFCOUNT
+  * @retval 0: success, 1: 중복, -1: event 등록 되지 않음 또는 error (0 이 아니면 node free)
+  */
+static int em_subscribe_node(em_event_group_type *group, int16_t signal, em_handler_list_type *node, uint16_t flags)
+{
+    em_event_id_type *evt_handler;
+    int ret = -1;
+
+    if(node == NULL) {
+        return -1;
+    }
+
+    /* GROUP의 모든 EVENT에 대해 통보*/
+    if(signal < 0) {
+        ret = em_handler_list_add(&group->grphandler, &group->grpindex, node, flags);
+    }
+    else {
+        /* single event에 대한 통보 */
+        evt_handler = getEventHandler(group, signal);
+        if(evt_handler) {
+            evt_handler->event = signal;
+            ret = em_handler_list_add(&evt_handler->handler, &evt_handler->index, node, flags);
+        }
+    }
+    if(ret == 0) {
+        return 0;
+    }
+
+    #ifdef PC_SIMULATION
+    free(node);
+    #else
+    vPortFree(node);
+    #endif 
+    return ret;
+}
+
+/**
+  * @brief  em_subscribe
+  * @note   handler 구독 (출력, fan-out 계산 없음)
+  *         EM_SUBSCRIBE_STICKY: 새로 추가 된 경우 cache 된 값 즉시 전달
+  * @param  None
+  * @retval em_subscribe_node()
+  */
+static int em_subscribe(em_event_group_type *group, int16_t signal, evt_handler_fp handler, uint16_t flags)
+{
+    em_event_id_type *evt_handler;
+    int ret = em_subscribe_node(group, signal, createNode(handler), flags);
+
+    if((ret == 0) && (flags & EM_SUBSCRIBE_STICKY)) {
+        if(signal < 0) {
+            for(evt_handler = group->evthandler; evt_handler; evt_handler = evt_handler->pNext) {
+                em_deliver_last_value(group, evt_handler, handler);
+            }
+        }
+        else {
+            em_deliver_last_value(group, getEventHandler(group, signal), handler);
+        }
+    }
+    return ret;
+}
+
+/**
+  * @brief  em_ring_reserve
+  * @note   lock-free MPSC ring slot 확보 (slot별 sequence, slot 첫 member는 uint32_t seq).
+  *         data 기록 후 seq = pos + 1 로 commit
+  * @param  max_retry: 0 이면 확보 될 때까지, 그 외 CAS 경합 시 retry 횟수 제한 (wait-free)
+  * @retval slot, NULL: ring full 또는 retry 초과
+  */
+static void *em_ring_reserve(void *slot, size_t slot_size, uint16_t depth, uint32_t *tail, uint16_t max_retry, uint32_t *ppos)
+{
+    uint32_t pos = __atomic_load_n(tail, __ATOMIC_RELAXED);
+    uint32_t *seq;
+    int32_t diff;
+
+    for(uint16_t retry = 0; (max_retry == 0) || (retry < max_retry); retry++) {
+        seq = (uint32_t *)((uint8_t *)slot + (pos & (depth - 1)) * slot_size);
+        diff = (int32_t)(__atomic_load_n(seq, __ATOMIC_ACQUIRE) - pos);
+        if(diff == 0) {
+            if(__atomic_compare_exchange_n(tail, &pos, pos + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                *ppos = pos;
+                return seq;
+            }
+        }
+        else if(diff < 0) {
+            return NULL;
+        }
+        else {
+            pos = __atomic_load_n(tail, __ATOMIC_RELAXED);
+        }
+    }
+    return NULL;
+}
+
+/**
+  * @brief  em_ring_peek
+  * @note   consumer: pos slot에 commit 된 data가 있는지 확인. 처리 후 seq = pos + depth 로 반환
+  * @param  None
+  * @retval slot, NULL: empty
+  */
+static void *em_ring_peek(void *slot, size_t slot_size, uint16_t depth, uint32_t pos)
+{
+    uint32_t *seq = (uint32_t *)((uint8_t *)slot + (pos & (depth - 1)) * slot_size);
+
+    if((int32_t)(__atomic_load_n(seq, __ATOMIC_ACQUIRE) - (pos + 1)) < 0) {
+        return NULL;
+    }
+    return seq;
+}
+
+/**
+  * @brief  em_mailbox_post
+  * @note   lock-free MPSC push (slot별 sequence). payload는 mailbox 소유로 복사
+  *         (EM_INLINE_PAYLOAD_SIZE 이하 inline, 그 이상 참조 count buffer)
+  * @param  None
+  * @retval 0: success, -1: mailbox full
+  */
+static int em_mailbox_post(em_mailbox_type *mailbox, const char *groupname, int16_t signal, em_event_arg_type *event)
+{
+    em_mailbox_slot_type *slot;
+    em_event_arg_type *arg;
+    uint32_t pos;
+
+    slot = em_ring_reserve(mailbox->slot, sizeof(em_mailbox_slot_type), mailbox->depth, &mailbox->tail, 0, &pos);
+    if(slot == NULL) {
+        __atomic_fetch_add(&mailbox->drop_cnt, 1, __ATOMIC_RELAXED);
+        return -1;
+    }
+
+    slot->item.groupname = groupname;
+    slot->item.signal = (uint16_t)signal | EM_GLOBAL_SIGNAL_FLAG;
+    slot->item.hasarg = (event != NULL) ? 1 : 0;
+    arg = &slot->item.arg;
+    if(event != NULL) {
+        if((event->msg == NULL) || (event->storage == EM_ARG_STORAGE_INLINE)) {
+            memcpy(arg, event, sizeof(em_event_arg_type));
+        }
+        else if(event->storage == EM_ARG_STORAGE_REFCOUNT) {
+            memcpy(arg, event, offsetof(em_event_arg_type, data));
+            EM_ARG_SET_REFCOUNT(arg, event->msg);
+            __atomic_add_fetch(&EM_PAYLOAD_REF(event->msg)->refcnt, 1, __ATOMIC_RELAXED);
+        }
+        else if(em_event_arg_set(arg, event->msg, event->len) < 0) {
+            slot->item.hasarg = 0;
+        }
+        arg->isconst = 1;
+    }
+
+    __atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+
+    if(mailbox->notify) {
+        mailbox->notify(mailbox, mailbox->notify_arg);
+    }
+    return 0;
+}
+
+/**
+  * @brief  em_find_handler_node
+  * @note   signal < 0 이면 group handler list에서 찾음
+  * @param  None
+  * @retval handler node, NULL: 등록 되지 않음
+  */
+static em_handler_list_type *em_find_handler_node(em_group_name_type *eventgroup, int16_t signal, evt_handler_fp handler)
+{
+    em_event_id_type *evt;
+    em_event_group_type *group = get_registered_group(eventgroup);
+
+    if((group == NULL) || (handler == NULL)) {
+        return NULL;
+    }
+    if(signal < 0) {
+        return em_handler_set_find(&group->grpindex, (uintptr_t)handler);
+    }
+    evt = getEventHandler(group, signal);
+    return evt ? em_handler_set_find(&evt->index, (uintptr_t)handler) : NULL;
+}
+
+/**
+  * @brief  em_dispatch
+  * @note   group handler, parent group handler, event handler 순서로 호출. ctx는 호출 thread(shard) 전용 이어야 함.
+  * @param  ctx: dispatch context, group_index: registered group index
+  * @retval None
+  */
+static void em_dispatch(em_dispatch_ctx_type *ctx, int16_t group_index, int16_t signal, em_event_arg_type *event)
+{
+    int16_t isbackupreq = -1;
+    const char *groupname;
+    em_fanout_type *fanout;
+
+    ctx->event_msg_backup = NULL;
+    ctx->current_event = NULL;
+    ctx->group = NULL;
+    ctx->gListHandler = NULL;
+    ctx->evt_handler = NULL;
+    ctx->eListHandler = NULL;
+
+    ctx->group = &root_event_list.group[group_index];
+    groupname = ctx->group->event_group.name;
+    /* handler 수행 중 구독 변경으로 교체 되어도 이 dispatch 끝날 때 까지 유지 */
+    fanout = em_fanout_acquire(ctx->group);
+
+    if(event != NULL) {
+        memcpy(&ctx->trigger_event, event, sizeof(em_event_arg_type));
+        ctx->current_event = &ctx->trigger_event;
+        EM_ARG_FIXUP(ctx->current_event);
+
+        em_payload_prepare(ctx, ctx->group, event);
+        isbackupreq = is_event_backup_require(group_index, ctx->current_event, signal, fanout);
+    }
+
+    /* last value cache update: handler에서 msg를 free 하기 전에 저장 */
+    ctx->evt_handler = getEventHandler(ctx->group, signal);
+    if(ctx->evt_handler && ctx->evt_handler->last) {
+        em_last_value_update(ctx->evt_handler->last, ctx->current_event);
+    }
+    /* 1. Group handler 
+    */    
+    ctx->gListHandler = ctx->group->grphandler;
+
+    if(ctx->gListHandler != NULL) {
+        /* default handler: memory free 하지 않도록 const로 전달 */
+        if(!ctx->group->attr.default_handler_free) {
+            em_event_arg_type arg;
+            if(ctx->current_event) {
+                memcpy(&arg, ctx->current_event, sizeof(em_event_arg_type));
+                arg.isconst = 1;
+            }
+            ctx->gListHandler->handler(groupname, signal, ctx->current_event ? &arg : NULL);
+            ctx->gListHandler = ctx->gListHandler->pNext;
+        }
+
+        while (ctx->gListHandler != NULL) {
+            em_invoke_handler(ctx, ctx->gListHandler, group_index, groupname, signal, isbackupreq);
+            ctx->gListHandler = ctx->gListHandler->pNext;
+        }
+    }
+
+    /* 1-1. Parent group handler: 미리 계산된 fan-out array
+    */
+    for(uint16_t i = 0; fanout && (i < fanout->cnt); i++) {
+        if(!em_fanout_is_subscribed(ctx->evt_handler, fanout->node[i])) {
+            em_invoke_handler(ctx, fanout->node[i], group_index, groupname, signal, isbackupreq);
+        }
+    }
+    if(fanout) {
+        em_fanout_release(ctx->group);
+    }
+
+    /* isbackupreq > 0 일 경우  1개의 event_msg_backup 남아 있음 
+       current_event->msg에 내용이 있음.
+    */
+
+    /* 2. Event handler 
+    */    
+    ctx->eListHandler = ctx->evt_handler ? ctx->evt_handler->handler : NULL;
+    while (ctx->eListHandler != NULL) {
+        em_invoke_handler(ctx, ctx->eListHandler, group_index, groupname, signal, isbackupreq);
+        ctx->eListHandler = ctx->eListHandler->pNext;
+    }
+    /* isbackupreq > 0 일 경우  1개의 event_msg_backup 남아 있음 */
+    if(ctx->event_msg_backup) {
+        #ifdef PC_SIMULATION
+        free(ctx->event_msg_backup);
+        #else
+        vPortFree(ctx->event_msg_backup);
+        #endif 
+    }
+
+    em_payload_finish(ctx, ctx->group, event);
+}
+
+/**
+  * @brief  em_queue_item_heap_len
+  * @note   queue item이 가지고 있는 heap msg 크기. 참조 count(payload_bytes에 포함), inline, const buffer는 0
+  * @param  None
+  * @retval heap msg byte
+  */
+static uint32_t em_queue_item_heap_len(const em_queue_item_type *item)
+{
+    if(!item->hasarg || (item->arg.msg == NULL) || (item->arg.storage != EM_ARG_STORAGE_HEAP)) {
+        return 0;
+    }
+    return (item->ownsmsg || !item->arg.isconst) ? item->arg.len : 0;
+}
+
+/**
+  * @brief  em_queue_init
+  * @note   shard queue 생성
+  * @param  None
+  * @retval 0: success, -1: error
+  */
+static int em_queue_init(em_queue_type *q)
+{
+    #ifdef PC_SIMULATION
+    q->head = 0;
+    q->tail = 0;
+    q->count = 0;
+    q->heap_bytes = 0;
+    q->evfd = -1;
+    q->signalled = 0;
+    if(pthread_mutex_init(&q->lock, NULL) != 0) {
+        return -1;
+    }
+    if(pthread_cond_init(&q->cond, NULL) != 0) {
+        pthread_mutex_destroy(&q->lock);
+        return -1;
+    }
+    #else
+    /* em_shard_stop() 이후 재시작: 기존 queue 재사용 */
+    if(q->handle != NULL) {
+        xQueueReset(q->handle);
+        return 0;
+    }
+    q->handle = xQueueCreate(EM_SHARD_QUEUE_DEPTH, sizeof(em_queue_item_type));
+    if(q->handle == NULL) {
+        return -1;
+    }
+    #endif
+    return 0;
+}
+
+/**
+  * @brief  em_queue_deinit
+  * @note   
+  * @param  None
+  * @retval None
+  */
+static void em_queue_deinit(em_queue_type *q)
+{
+    #ifdef PC_SIMULATION
+    pthread_cond_destroy(&q->cond);
+    pthread_mutex_destroy(&q->lock);
+    #else
+    vQueueDelete(q->handle);
+    q->handle = NULL;
+    #endif
+}
+
+/**
+  * @brief  em_queue_send
+  * @note   queue full 이면 기다리지 않고 error return
+  * @param  None
+  * @retval 0: success, -1: queue full
+  */
+static int em_queue_send(em_queue_type *q, const em_queue_item_type *item)
+{
+    #ifdef PC_SIMULATION
+    int wakeup = 0;
+
+    pthread_mutex_lock(&q->lock);
+    if(q->count >= EM_SHARD_QUEUE_DEPTH) {
+        pthread_mutex_unlock(&q->lock);
+        return -1;
+    }
+    memcpy(&q->item[q->tail], item, sizeof(em_queue_item_type));
+    q->tail = (q->tail + 1) % EM_SHARD_QUEUE_DEPTH;
+    q->count++;
+    q->heap_bytes += em_queue_item_heap_len(item);
+    /* eventfd wakeup은 drain 1회당 1번 */
+    if((q->evfd >= 0) && !q->signalled) {
+        q->signalled = 1;
+        wakeup = 1;
+    }
+    pthread_cond_signal(&q->cond);
+    pthread_mutex_unlock(&q->lock);
+
+    if(wakeup) {
+        uint64_t one = 1;
+        if(write(q->evfd, &one, sizeof(one)) != sizeof(one)) {
+            printf("eventfd write error\n");
+        }
+    }
+    #else
+    if(xQueueSend(q->handle, item, 0) != pdPASS) {
+        return -1;
+    }
+    __atomic_add_fetch(&q->heap_bytes, em_queue_item_heap_len(item), __ATOMIC_RELAXED);
+    #endif
+    return 0;
+}
+
+/**
+  * @brief  em_queue_receive
+  * @note   item이 들어올 때까지 대기
+  * @param  None
+  * @retval None
+  */
+static void em_queue_receive(em_queue_type *q, em_queue_item_type *item)
+{
+    #ifdef PC_SIMULATION
+    pthread_mutex_lock(&q->lock);
+    while(q->count == 0) {
+        pthread_cond_wait(&q->cond, &q->lock);
+    }
+    memcpy(item, &q->item[q->head], sizeof(em_queue_item_type));
+    q->head = (q->head + 1) % EM_SHARD_QUEUE_DEPTH;
+    q->count--;
+    q->heap_bytes -= em_queue_item_heap_len(item);
+    pthread_mutex_unlock(&q->lock);
+    #else
+    xQueueReceive(q->handle, item, portMAX_DELAY);
+    __atomic_sub_fetch(&q->heap_bytes, em_queue_item_heap_len(item), __ATOMIC_RELAXED);
+    #endif
+}
+
+/**
+  * @brief  em_run_offloaded
+  * @note   executor lane에서 offload 된 handler 수행
+  * @param  None
+  * @retval None
+  */
+static void em_run_offloaded(em_queue_item_type *item)
+{
+    const char *groupname = root_event_list.group[item->group_index].event_group.name;
+
+    EM_ARG_FIXUP(&item->arg);
+    item->node->handler(groupname, item->signal, item->hasarg ? &item->arg : NULL);
+    if(item->ownsmsg) {
+        em_payload_drop(&item->arg);
+    }
+}
+
+/**
+  * @brief  em_queue_try_receive
+  * @note   기다리지 않음
+  * @param  None
+  * @retval 0: success, -1: queue empty
+  */
+static int em_queue_try_receive(em_queue_type *q, em_queue_item_type *item)
+{
+    #ifdef PC_SIMULATION
+    pthread_mutex_lock(&q->lock);
+    if(q->count == 0) {
+        pthread_mutex_unlock(&q->lock);
+        return -1;
+    }
+    memcpy(item, &q->item[q->head], sizeof(em_queue_item_type));
+    q->head = (q->head + 1) % EM_SHARD_QUEUE_DEPTH;
+    q->count--;
+    q->heap_bytes -= em_queue_item_heap_len(item);
+    pthread_mutex_unlock(&q->lock);
+    #else
+    if(xQueueReceive(q->handle, item, 0) != pdPASS) {
+        return -1;
+    }
+    __atomic_sub_fetch(&q->heap_bytes, em_queue_item_heap_len(item), __ATOMIC_RELAXED);
+    #endif
+    return 0;
+}
+
+/**
+  * @brief  em_queue_pending
+  * @note   queue에 대기 중인 item 수
+  * @param  heap_bytes: NULL이 아니면 대기 item의 heap msg byte를 더함
+  * @retval None
+  */
+static uint32_t em_queue_pending(em_queue_type *q, uint32_t *heap_bytes)
+{
+    uint32_t count;
+
+    #ifdef PC_SIMULATION
+    pthread_mutex_lock(&q->lock);
+    count = q->count;
+    if(heap_bytes) {
+        *heap_bytes += q->heap_bytes;
+    }
+    pthread_mutex_unlock(&q->lock);
+    #else
+    count = (q->handle != NULL) ? (uint32_t)uxQueueMessagesWaiting(q->handle) : 0;
+    if(heap_bytes) {
+        *heap_bytes += __atomic_load_n(&q->heap_bytes, __ATOMIC_RELAXED);
+    }
+    #endif
+    return count;
+}
+
+/**
+  * @brief  em_host_init
+  * @note   host event loop lane queue 생성 (처음 한번)
+  * @param  None
+  * @retval 0: success, -1: error
+  */
+static int em_host_init(void)
+{
+    if(em_host_ready) {
+        return 0;
+    }
+    memset(&em_host.ctx, 0x00, sizeof(em_dispatch_ctx_type));
+    em_host.cpu = -1;
+    if(em_queue_init(&em_host.queue) < 0) {
+        return -1;
+    }
+    #ifdef PC_SIMULATION
+    em_host.queue.evfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if(em_host.queue.evfd < 0) {
+        em_queue_deinit(&em_host.queue);
+        return -1;
+    }
+    #endif
+    __atomic_store_n(&em_host_ready, 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+/**
+  * @brief  em_shard_dispatcher
+  * @note   shard dispatcher loop. stop request(group_index < 0) 받을 때까지 수행
+  * @param  None
+  * @retval None
+  */
+#ifdef PC_SIMULATION
+static void *em_shard_dispatcher(void *arg)
+#else
+static void em_shard_dispatcher(void *arg)
+#endif
+{
+    em_shard_type *shard = (em_shard_type *)arg;
+    em_queue_item_type item;
+
+    for(;;) {
+        em_queue_receive(&shard->queue, &item);
+        if(item.group_index < 0) {
+            break;
+        }
+        if(item.node != NULL) {
+            em_run_offloaded(&item);
+            continue;
+        }
+        em_dispatch(&shard->ctx, item.group_index, item.signal, item.hasarg ? &item.arg : NULL);
+    }
+
+    /* stop request 뒤에 들어온 item도 처리 (payload leak 방지) */
+    while(em_queue_try_receive(&shard->queue, &item) == 0) {
+        if(item.group_index < 0) {
+            continue;
+        }
+        if(item.node != NULL) {
+            em_run_offloaded(&item);
+            continue;
+        }
+        em_dispatch(&shard->ctx, item.group_index, item.signal, item.hasarg ? &item.arg : NULL);
+    }
+
+    #ifdef PC_SIMULATION
+    return NULL;
+    #else
+    vTaskDelete(NULL);
+    #endif
+}
+
+/**
+  * @brief  em_shard_create
+  * @note   shard queue, dispatcher thread(task) 생성
+  * @param  cpu: 고정할 CPU, < 0 이면 고정 하지 않음
+  * @retval 0: success, -1: error
+  */
+static int em_shard_create(em_shard_type *shard, int16_t cpu)
+{
+    memset(&shard->ctx, 0x00, sizeof(em_dispatch_ctx_type));
+    shard->cpu = cpu;
+    if(em_queue_init(&shard->queue) < 0) {
+        return -1;
+    }
+
+    #ifdef PC_SIMULATION
+    if(pthread_create(&shard->thread, NULL, em_shard_dispatcher, shard) != 0) {
+        em_queue_deinit(&shard->queue);
+        return -1;
+    }
+    if(cpu >= 0) {
+        #ifdef CPU_SET
+        cpu_set_t cpuset;
+        CPU_ZERO(&cpuset);
+        CPU_SET(cpu, &cpuset);
+        if(pthread_setaffinity_np(shard->thread, sizeof(cpu_set_t), &cpuset) != 0) {
+            printf("Dispatcher CPU(%d) affinity failed\n", cpu);
+        }
+        #else
+        /* _GNU_SOURCE 없이 build: affinity 설정 안함 */
+        printf("Dispatcher CPU(%d) affinity not supported (build without _GNU_SOURCE)\n", cpu);
+        #endif
+    }
+    #else
+    if(xTaskCreate(em_shard_dispatcher, "em_shard", EM_SHARD_TASK_STACK_SIZE, shard,
+                   EM_SHARD_TASK_PRIORITY, &shard->task) != pdPASS) {
+        em_queue_deinit(&shard->queue);
+        return -1;
+    }
+    #if defined(configUSE_CORE_AFFINITY) && (configUSE_CORE_AFFINITY == 1)
+    if(cpu >= 0) {
+        vTaskCoreAffinitySet(shard->task, (UBaseType_t)1 << cpu);
+    }
+    #endif
+    #endif
+    return 0;
+}
+
+/**
+  * @brief  em_shard_destroy
+  * @note   queue에 남아 있는 item 처리 후 dispatcher 종료
+  * @param  None
+  * @retval None
+  */
+static void em_shard_destroy(em_shard_type *shard)
+{
+    em_queue_item_type item;
+
+    memset(&item, 0x00, sizeof(em_queue_item_type));
+    item.group_index = -1;
+
+    #ifdef PC_SIMULATION
+    /* stop request는 drop 되면 안됨 */
+    while(em_queue_send(&shard->queue, &item) < 0) {
+        sched_yield();
+    }
+    pthread_join(shard->thread, NULL);
+    em_queue_deinit(&shard->queue);
+    #else
+    while(em_queue_send(&shard->queue, &item) < 0) {
+        vTaskDelay(1);
+    }
+    /* queue는 dispatcher task 종료 후 삭제 해야 하므로 유지 */
+    #endif
+}
+
+/**
+  * @brief  em_offload_drop
+  * @note   offload 실패로 event drop. handler에 소유권이 넘어가는 msg(transfer > 0, EM_PAYLOAD_COPY)는 여기서 free
+  * @param  None
+  * @retval None
+  */
+static void em_offload_drop(em_event_arg_type *event, int16_t transfer)
+{
+    if((transfer > 0) && (event != NULL) && (event->storage == EM_ARG_STORAGE_HEAP)) {
+        EM_IS_MEMFREEREQUIRED(event);
+    }
+}
+
+/**
+  * @brief  em_lane_enter
+  * @note   lane(shard, executor) queue 사용 시작. 동작 중(state 2)이 아니면 사용 하지 않음 (em_lane_leave() 필요 없음)
+  *         lane 정지 시 state를 3으로 바꾼 후 사용 중인 호출(users)이 끝날 때 까지 기다린 후 queue 삭제
+  * @param  None
+  * @retval 1: 사용 가능, 0: lane 동작 중 아님
+  */
+static int em_lane_enter(uint8_t *state, uint32_t *users)
+{
+    __atomic_add_fetch(users, 1, __ATOMIC_SEQ_CST);
+    if(__atomic_load_n(state, __ATOMIC_SEQ_CST) != 2) {
+        __atomic_sub_fetch(users, 1, __ATOMIC_RELEASE);
+        return 0;
+    }
+    return 1;
+}
+
+/**
+  * @brief  em_lane_leave
+  * @note   
+  * @param  None
+  * @retval None
+  */
+static void em_lane_leave(uint32_t *users)
+{
+    __atomic_sub_fetch(users, 1, __ATOMIC_RELEASE);
+}
+
+/**
+  * @brief  em_lane_wait
+  * @note   사용 중인 호출(users)이 끝날 때 까지 대기
+  * @param  None
+  * @retval None
+  */
+static void em_lane_wait(uint32_t *users)
+{
+    while(__atomic_load_n(users, __ATOMIC_SEQ_CST) != 0) {
+        #ifdef PC_SIMULATION
+        sched_yield();
+        #else
+        vTaskDelay(1);
+        #endif
+    }
+}
+
+/**
+  * @brief  em_lane_quiesce
+  * @note   state 2 -> 3 (정지 중) 후 사용 중인 호출이 끝날 때 까지 대기 (users == NULL 이면 호출 하는 쪽에서 대기)
+  * @param  None
+  * @retval 1: 정지 해야 함, 0: 동작 중 아님
+  */
+static int em_lane_quiesce(uint8_t *state, uint32_t *users)
+{
+    uint8_t expected = 2;
+
+    if(!__atomic_compare_exchange_n(state, &expected, 3, 0, __ATOMIC_SEQ_CST, __ATOMIC_ACQUIRE)) {
+        return 0;
+    }
+    if(users != NULL) {
+        em_lane_wait(users);
+    }
+    return 1;
+}
+
+/* shard user count는 lane(group gid) 별로 분산: post 마다 같은 cache line을 쓰지 않도록.
+   lane에 상관 없이 enter 하면 모든 shard가 유지 됨 (em_shard_stop()은 모든 lane counter 대기) */
+#define em_shard_enter(lane)    em_lane_enter(&em_shard_state, &em_shard[(lane) % MAX_EM_SHARD_COUNT].users)
+#define em_shard_leave(lane)    em_lane_leave(&em_shard[(lane) % MAX_EM_SHARD_COUNT].users)
+
+/**
+  * @brief  em_offload_handler
+  * @note   slow handler를 executor lane으로 전달. executor는 처음 필요할 때 생성
+  *         transfer > 0: msg 소유권을 handler로 넘김 (handler에서 free)
+  *         그 외: msg 복사본 전달, executor에서 handler 수행 후 free
+  * @param  None
+  * @retval 0: success, -1: executor 사용 불가 (event drop)
+  */
+static int em_offload_handler(em_handler_list_type *node, int16_t group_index, int16_t signal,
+                              em_event_arg_type *event, int16_t transfer)
+{
+    em_queue_item_type item;
+    uint8_t expected;
+    int ret;
+
+    /* executor lane 생성 (처음 한번), 다른 thread가 생성 중이면 대기, 정지 중이면 drop */
+    while(!em_lane_enter(&em_executor_state, &em_executor_users)) {
+        if(__atomic_load_n(&em_executor_state, __ATOMIC_ACQUIRE) == 3) {
+            em_offload_drop(event, transfer);
+            return -1;
+        }
+        expected = 0;
+        if(__atomic_compare_exchange_n(&em_executor_state, &expected, 1, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            if(em_shard_create(&em_executor, -1) < 0) {
+                __atomic_store_n(&em_executor_state, 0, __ATOMIC_RELEASE);
+                em_offload_drop(event, transfer);
+                return -1;
+            }
+            __atomic_store_n(&em_executor_state, 2, __ATOMIC_RELEASE);
+            continue;
+        }
+        #ifdef PC_SIMULATION
+        sched_yield();
+        #else
+        vTaskDelay(1);
+        #endif
+    }
+
+    memset(&item, 0x00, sizeof(em_queue_item_type));
+    item.group_index = group_index;
+    item.signal = signal;
+    item.node = node;
+    item.hasarg = (event != NULL) ? 1 : 0;
+    if(event != NULL) {
+        memcpy(&item.arg, event, sizeof(em_event_arg_type));
+        if((event->storage == EM_ARG_STORAGE_REFCOUNT) && (event->msg != NULL)) {
+            /* 참조 count 증가, executor에서 handler 수행 후 감소 */
+            __atomic_add_fetch(&EM_PAYLOAD_REF(event->msg)->refcnt, 1, __ATOMIC_RELAXED);
+            item.ownsmsg = 1;
+        }
+        else if((transfer <= 0) && (event->msg != NULL) && (event->storage != EM_ARG_STORAGE_INLINE)) {
+            #ifdef PC_SIMULATION
+            item.arg.msg = malloc(event->len + 1);
+            #else
+            item.arg.msg = pvPortMalloc(event->len + 1);
+            #endif 
+            if(item.arg.msg == NULL) {
+                em_lane_leave(&em_executor_users);
+                return -1;
+            }
+            memset(item.arg.msg, 0x00, event->len + 1);
+            memcpy(item.arg.msg, event->msg, event->len);
+            item.arg.isconst = 1;
+            item.arg.storage = EM_ARG_STORAGE_HEAP;
+            item.ownsmsg = 1;
+        }
+    }
+
+    ret = em_queue_send(&em_executor.queue, &item);
+    em_lane_leave(&em_executor_users);
+    if(ret < 0) {
+        if(item.ownsmsg) {
+            em_payload_drop(&item.arg);
+        }
+        else {
+            em_offload_drop(event, transfer);
+        }
+        return -1;
+    }
+    return 0;
+}
+
+/**
+  * @brief  em_get_group_shard
+  * @note   group을 소유한 shard index
+  * @param  None
+  * @retval shard index
+  */
+static uint16_t em_get_group_shard(em_event_group_type *group)
+{
+    int16_t shard = __atomic_load_n(&group->shard, __ATOMIC_ACQUIRE);
+
+    if((shard < 0) || (shard >= em_shard_count)) {
+        shard = group->event_group.gid % em_shard_count;
+    }
+    return (uint16_t)shard;
+}
+
+/**
+  * @brief  em_arena_free
+  * @note   em_compact() 이전 node free. arena 안의 node는 arena와 함께 free
+  * @param  None
+  * @retval None
+  */
+static void em_arena_free(void *ptr)
+{
+    if((ptr == NULL) ||
+       ((em_arena != NULL) && ((uint8_t *)ptr >= em_arena) && ((uint8_t *)ptr < em_arena + em_arena_size))) {
+        return;
+    }
+    #ifdef PC_SIMULATION
+    free(ptr);
+    #else
+    vPortFree(ptr);
+    #endif 
+}
+
+/**
+  * @brief  em_compact_list
+  * @note   handler list를 arena(*pos)로 순서대로 복사 후 이전 node free
+  * @param  None
+  * @retval 새 list head
+  */
+static em_handler_list_type *em_compact_list(em_handler_list_type *head, uint8_t **pos)
+{
+    em_handler_list_type *first = NULL, *prev = NULL, *copy, *node, *next;
+
+    for(node = head; node != NULL; node = next) {
+        next = node->pNext;
+        copy = (em_handler_list_type *)*pos;
+        *pos += sizeof(em_handler_list_type);
+
+        memcpy(copy, node, sizeof(em_handler_list_type));
+        copy->pNext = NULL;
+        if(prev) {
+            prev->pNext = copy;
+        }
+        else {
+            first = copy;
+        }
+        prev = copy;
+        em_arena_free(node);
+    }
+    return first;
+}
+
+/**
+  * @brief  em_is_quiescent
+  * @note   node 포인터를 가진 dispatcher(shard, executor, host queue)가 없는지
+  * @param  None
+  * @retval 1: quiescent
+  */
+static int em_is_quiescent(void)
+{
+    if(__atomic_load_n(&em_shard_state, __ATOMIC_ACQUIRE) != 0) {
+        return 0;
+    }
+    if(__atomic_load_n(&em_executor_state, __ATOMIC_ACQUIRE) != 0) {
+        return 0;
+    }
+    if(em_host_ready && (em_queue_pending(&em_host.queue, NULL) > 0)) {
+        return 0;
+    }
+    return 1;
+}
+
+/* Global function code ------------------------------------------------------*/
+
+/**
+  * @brief  em_on_event
+  * @note   Event request
+  * @param  None
+  * @retval None
+  */
+void em_on_event(em_group_name_type *eventgroup, int16_t signal, evt_handler_fp handler)
+{
+    em_on_event_ex(eventgroup, signal, handler, 0);
+}
+
+/**
+  * @brief  em_on_event_ex
+  * @note   Event request with flags
+  *         EM_SUBSCRIBE_STICKY: cache 된 값이 있으면 등록 즉시 전달
+  *         (signal < 0 이면 group의 cache 된 모든 event 전달)
+  * @param  None
+  * @retval None
+  */
+void em_on_event_ex(em_group_name_type *eventgroup, int16_t signal, evt_handler_fp handler, uint16_t flags)
+{
+    em_event_group_type *group;
+    int ret;
+
+    if( eventgroup->name && handler ) {
+        /* 등록된 그룹인지 확인 한다. */
+        group = get_registered_group(eventgroup);
+        if( group != NULL ) {
+            ret = em_subscribe(group, signal, handler, flags);
+            if(ret == 0) {
+                /* 하위 group fan-out 다시 계산 */
+                if(signal < 0) {
+                    em_group_rebuild_fanout(group->event_group.gid);
+                }
+                #ifdef PC_SIMULATION
+                printf("Event group(%s) Event(0x%04x) is requested!!!\n", eventgroup->name, signal);
                 #else
-                em_event_id_type *evhandle = (em_event_id_type *)pvPortMalloc(sizeof(em_event_id_type)*event_count);
-                #endif 
-                memset(evhandle,0,sizeof(em_event_id_type)*event_count);
-                group->evthandler = evhandle; /* array로 access 하면 됨 */
-                group->group_evt_cnt = event_count;
+                DEBUGMED(GEN,"Event group(%s) Event(0x%04x) is requested!!!\n", eventgroup->name, signal);
+                #endif         
+            }
+            else if(ret > 0) {
+                #ifdef PC_SIMULATION
+                printf("Event group(%s) Event(0x%04x) already requested!!! (%s)\n", eventgroup->name, signal,
+                       (flags & EM_SUBSCRIBE_REFCOUNT) ? "refcount" : "rejected");
+                #else
+                DEBUGMED(GEN,"Event group(%s) Event(0x%04x) already requested!!! (%s)\n", eventgroup->name, signal,
+                       (flags & EM_SUBSCRIBE_REFCOUNT) ? "refcount" : "rejected");
+                #endif         
+            }
+        }
+        else {
+            /* group 등록이 되어 있지 않음 */
+            #ifdef PC_SIMULATION
+            printf("Event group(%s) not registered!!!\n", eventgroup->name);
+            #else
+            DEBUGMED(GEN,"Event group(%s)not registered!!!\n", eventgroup->name);
+            #endif             
+        }
+    }
+    else {
+        #ifdef PC_SIMULATION
+        printf("Group, Handler must be defined!!!\n");
+        #else
+        DEBUGMED(GEN,"Group, Handler must be defined!!!\n");
+        #endif   
+    }
+}
+
+/**
+  * @brief  em_on_events_bulk
+  * @note   여러 (group, signal, handler) 한번에 구독. 개별 출력 없음,
+  *         parent fan-out은 마지막에 변경 된 group만 한번 계산
+  * @param  None
+  * @retval 구독 된 수 (EM_SUBSCRIBE_REFCOUNT 중복 포함), -1: error
+  */
+int em_on_events_bulk(const em_subscription_type *subs, uint16_t count)
+{
+    em_event_group_type *group;
+    uint8_t changed[MAX_ROOT_EVENT_GROUP_COUNT] = {0};
+    int subscribed = 0, ret;
+
+    if(subs == NULL) {
+        return -1;
+    }
+
+    for(uint16_t i = 0; i < count; i++) {
+        if((subs[i].eventgroup == NULL) || (subs[i].eventgroup->name == NULL) || (subs[i].handler == NULL)) {
+            continue;
+        }
+        group = get_registered_group(subs[i].eventgroup);
+        if(group == NULL) {
+            continue;
+        }
+        ret = em_subscribe(group, subs[i].signal, subs[i].handler, subs[i].flags);
+        if(ret == 0) {
+            subscribed++;
+            if(subs[i].signal < 0) {
+                changed[group->event_group.gid] = 1;
+            }
+        }
+        else if((ret > 0) && (subs[i].flags & EM_SUBSCRIBE_REFCOUNT)) {
+            subscribed++;
+        }
+    }
+
+    for(int16_t g = 0; g < root_event_list.group_cnt; g++) {
+        if(changed[g]) {
+            em_group_rebuild_fanout(g);
+        }
+    }
+
+    #ifdef PC_SIMULATION
+    printf("%d/%d events are requested!!!\n", subscribed, count);
+    #else
+    DEBUGMED(GEN,"%d/%d events are requested!!!\n", subscribed, count);
+    #endif         
+    return subscribed;
+}
+
+/**
+  * @brief  em_mailbox_init
+  * @note   slot은 호출자가 할당 (depth 갯수), mailbox 소유 task 1개만 em_mailbox_drain() 해야 함
+  * @param  depth: 2^n
+  * @retval 0: success, -1: error
+  */
+int em_mailbox_init(em_mailbox_type *mailbox, em_mailbox_slot_type *slot, uint16_t depth)
+{
+    if((mailbox == NULL) || (slot == NULL) || (depth == 0) || (depth & (depth - 1))) {
+        return -1;
+    }
+    memset(mailbox, 0x00, sizeof(em_mailbox_type));
+    mailbox->slot = slot;
+    mailbox->depth = depth;
+    for(uint16_t i = 0; i < depth; i++) {
+        slot[i].seq = i;
+    }
+    return 0;
+}
+
+/**
+  * @brief  em_mailbox_set_notify
+  * @note   item post 후 dispatcher context에서 호출 (xTaskNotifyGive(), sem_post() 등)
+  * @param  None
+  * @retval None
+  */
+void em_mailbox_set_notify(em_mailbox_type *mailbox, em_mailbox_notify_fp notify, void *arg)
+{
+    mailbox->notify_arg = arg;
+    mailbox->notify = notify;
+}
+
+/**
+  * @brief  em_on_event_mailbox
+  * @note   Event request, handler 대신 subscriber mailbox로 전달 (signal | EM_GLOBAL_SIGNAL_FLAG)
+  * @param  signal: < 0 이면 group 모든 event
+  * @retval None
+  */
+void em_on_event_mailbox(em_group_name_type *eventgroup, int16_t signal, em_mailbox_type *mailbox)
+{
+    em_handler_list_type *new_node;
+    em_event_group_type *group;
+
+    if( (eventgroup->name == NULL) || (mailbox == NULL) ) {
+        #ifdef PC_SIMULATION
+        printf("Group, Mailbox must be defined!!!\n");
+        #else
+        DEBUGMED(GEN,"Group, Mailbox must be defined!!!\n");
+        #endif   
+        return;
+    }
+
+    group = get_registered_group(eventgroup);
+    if(group == NULL) {
+        #ifdef PC_SIMULATION
+        printf("Event group(%s) not registered!!!\n", eventgroup->name);
+        #else
+        DEBUGMED(GEN,"Event group(%s)not registered!!!\n", eventgroup->name);
+        #endif             
+        return;
+    }
+
+    new_node = createNode(NULL);
+    if(new_node == NULL) {
+        return;
+    }
+    new_node->mailbox = mailbox;
+    new_node->budget_us = 0;
+    if(em_subscribe_node(group, signal, new_node, 0) == 0) {
+        if(signal < 0) {
+            em_group_rebuild_fanout(group->event_group.gid);
+        }
+        #ifdef PC_SIMULATION
+        printf("Event group(%s) Event(0x%04x) is requested to mailbox!!!\n", eventgroup->name, signal);
+        #else
+        DEBUGMED(GEN,"Event group(%s) Event(0x%04x) is requested to mailbox!!!\n", eventgroup->name, signal);
+        #endif         
+    }
+}
+
+/**
+  * @brief  em_mailbox_drain
+  * @note   mailbox 소유 task에서 한번에 max_items 까지 꺼냄.
+  *         처리 후 각 item에 대해 em_event_arg_release(&item[i].arg) 해야 함
+  * @param  None
+  * @retval 꺼낸 item 수
+  */
+uint16_t em_mailbox_drain(em_mailbox_type *mailbox, em_mailbox_item_type *item, uint16_t max_items)
+{
+    em_mailbox_slot_type *slot;
+    uint32_t pos = mailbox->head;
+    uint16_t count = 0;
+
+    while(count < max_items) {
+        slot = em_ring_peek(mailbox->slot, sizeof(em_mailbox_slot_type), mailbox->depth, pos);
+        if(slot == NULL) {
+            break;
+        }
+        memcpy(&item[count], &slot->item, sizeof(em_mailbox_item_type));
+        EM_ARG_FIXUP(&item[count].arg);
+        __atomic_store_n(&slot->seq, pos + mailbox->depth, __ATOMIC_RELEASE);
+        pos++;
+        count++;
+    }
+    mailbox->head = pos;
+    return count;
+}
+
+/**
+  * @brief  em_events_register
+  * @note   Event register, 기본 attribute(DEFAULT_HANDLER_NO_MEM_FREE, HANDLER_REQUIRED_MEMORYFREE,
+  *         FEATURE_SEQUENCE_EVENT_ENUM) 사용
+  * @param  FEATURE_SEQUENCE_EVENT_ENUM > 0: event 갯수, 그 외: event enum
+  * @retval None
+  */
+void em_events_register(em_group_name_type *eventgroup, int16_t event)
+{
+    em_group_attr_type attr;
+
+    attr.lookup = (FEATURE_SEQUENCE_EVENT_ENUM > 0) ? EM_LOOKUP_DENSE : EM_LOOKUP_HASH;
+    attr.payload = (HANDLER_REQUIRED_MEMORYFREE > 0) ? EM_PAYLOAD_COPY : EM_PAYLOAD_BORROW;
+    attr.default_handler_free = (DEFAULT_HANDLER_NO_MEM_FREE > 0) ? 0 : 1;
+
+    em_events_register_ex(eventgroup, event, &attr);
+}
+
+/**
+  * @brief  em_events_register_ex
+  * @note   Event register with group attribute. attribute는 group 처음 등록 시에만 적용
+  *         EM_LOOKUP_DENSE: event = event 갯수, 한번에 등록
+  *         EM_LOOKUP_HASH : event = event enum, event별로 등록
+  * @param  None
+  * @retval 0: success, -1: error
+  */
+int em_events_register_ex(em_group_name_type *eventgroup, int16_t event, const em_group_attr_type *attr)
+{
+    uint16_t grp_cnt = root_event_list.group_cnt;
+    em_event_id_type *evt_handler;
+
+    if( (eventgroup->name == NULL) || (attr == NULL) ) {
+        /* group은 null이면 안됨 */
+        return -1;
+    }
+
+    /*새로운 GROUP인지, 이미 등록된 그룹인지 */
+    em_event_group_type *group = get_registered_group(eventgroup);
+    if( group == NULL ) {
+        if(grp_cnt >= MAX_ROOT_EVENT_GROUP_COUNT) {
+            #ifdef PC_SIMULATION
+            printf("%s Group count exceeded!!!\n", eventgroup->name);
+            #else
+            DEBUGERR(GEN,"%s Group count exceeded!!!\n", eventgroup->name);
+            #endif                  
+            return -1;
+        }
+        group = &root_event_list.group[grp_cnt];
+
+        group->event_group.name = eventgroup->name;
+        group->event_group.gid = grp_cnt;
+        memcpy(&group->attr, attr, sizeof(em_group_attr_type));
+
+        eventgroup->gid = grp_cnt;
+
+        /* Add Group Handler */
+        em_handler_list_add(&group->grphandler, &group->grpindex, createNode(em_default_handler), 0);
+
+        root_event_list.group_cnt++;
+
+        /* Add event andler */
+        if(group->attr.lookup == EM_LOOKUP_DENSE) {
+            #ifdef PC_SIMULATION
+            em_event_id_type *evhandle = (em_event_id_type *)malloc(sizeof(em_event_id_type)*event);
+            #else
+            em_event_id_type *evhandle = (em_event_id_type *)pvPortMalloc(sizeof(em_event_id_type)*event);
+            #endif 
+            memset(evhandle,0,sizeof(em_event_id_type)*event);
+            for(int16_t i = 0; i < event; i++) {
+                evhandle[i].event = i;
+                evhandle[i].pNext = (i + 1 < event) ? &evhandle[i + 1] : NULL;
+            }
+            group->evthandler = evhandle; /* array로 access 하면 됨 */
+            group->group_evt_cnt = event;
+            return 0;
+        }
+    }
+    else if(group->attr.lookup == EM_LOOKUP_DENSE) {
+        #ifdef PC_SIMULATION
+        printf("%s Group already registered!!!\n", eventgroup->name);
+        #else
+        DEBUGERR(GEN,"%s Group already registered!!!\n", eventgroup->name);
+        #endif                  
+        return -1;
+    }
+
+    /* EM_LOOKUP_HASH: event 추가 */
+    if(getEventHandler(group, event) != NULL) {
+        #ifdef PC_SIMULATION
+        printf("%s Event(0x%04x) already registered!!!\n", eventgroup->name, event);
+        #else
+        DEBUGERR(GEN,"%s Event(0x%04x) already registered!!!\n", eventgroup->name, event);
+        #endif                  
+        return -1;
+    }
+
+    #ifdef PC_SIMULATION
+    evt_handler = (em_event_id_type *)malloc(sizeof(em_event_id_type));
+    #else
+    evt_handler = (em_event_id_type *)pvPortMalloc(sizeof(em_event_id_type));
+    #endif 
+    if(evt_handler == NULL) {
+        return -1;
+    }
+    memset(evt_handler, 0x00, sizeof(em_event_id_type));
+    evt_handler->event = event;
+
+    if(em_evt_hash_insert(group, evt_handler) < 0) {
+        #ifdef PC_SIMULATION
+        free(evt_handler);
+        #else
+        vPortFree(evt_handler);
+        #endif 
+        return -1;
+    }
+    addToTailEventList(&group->evthandler, evt_handler);
+    group->group_evt_cnt++;
+    return 0;
+}
+
+/**
+  * @brief  em_group_set_parent
+  * @note   parentgroup의 group handler(signal < 0 구독)가 eventgroup event도 받음.
+  *         parentgroup == NULL 이면 분리. fan-out은 여기서 다시 계산 (dispatch 중 호출 가능, 구독 함수 끼리는 동시 호출 금지)
+  * @param  None
+  * @retval 0: success, -1: error (미등록 group 또는 cycle)
+  */
+int em_group_set_parent(em_group_name_type *eventgroup, em_group_name_type *parentgroup)
+{
+    em_event_group_type *group = get_registered_group(eventgroup);
+    em_event_group_type *parent;
+    int16_t group_index, parent_index = -1;
+
+    if(group == NULL) {
+        return -1;
+    }
+    group_index = (int16_t)group->event_group.gid;
+
+    if(parentgroup != NULL) {
+        parent = get_registered_group(parentgroup);
+        if(parent == NULL) {
+            return -1;
+        }
+        parent_index = (int16_t)parent->event_group.gid;
+        /* cycle: parent가 자기 자신 또는 하위 group */
+        if(em_group_is_descendant(parent_index, group_index)) {
+            #ifdef PC_SIMULATION
+            printf("%s Group hierarchy cycle!!!\n", eventgroup->name);
+            #else
+            DEBUGERR(GEN,"%s Group hierarchy cycle!!!\n", eventgroup->name);
+            #endif                  
+            return -1;
+        }
+    }
+
+    group->parent = parent_index;
+    em_group_rebuild_fanout(group_index);
+    return 0;
+}
+
+/**
+  * @brief  em_event_arg_set
+  * @note   EM_INLINE_PAYLOAD_SIZE 이하는 inline(heap 사용 안함),
+  *         그 이상은 참조 count buffer로 복사. 소유권은 trigger/post 시 event manager로 넘어감
+  * @param  None
+  * @retval 0: success, -1: memory allocation error
+  */
+int em_event_arg_set(em_event_arg_type *event, const void *data, uint16_t len)
+{
+    em_payload_ref_type *ref;
+
+    if(event == NULL) {
+        return -1;
+    }
+    memset(event, 0x00, offsetof(em_event_arg_type, data));
+    event->len = len;
+
+    if(len <= EM_INLINE_PAYLOAD_SIZE) {
+        if(len) {
+            memcpy(event->data, data, len);
+        }
+        event->storage = EM_ARG_STORAGE_INLINE;
+        event->isconst = 1;
+        event->msg = event->data;
+        return 0;
+    }
+
+    ref = em_payload_ref_new(data, len);
+    if(ref == NULL) {
+        return -1;
+    }
+    EM_ARG_SET_REFCOUNT(event, ref->data);
+    return 0;
+}
+
+/**
+  * @brief  em_event_arg_retain
+  * @note   EM_PAYLOAD_REFCOUNT group handler에서 payload를 보관 할 때 사용.
+  *         handler argument를 복사 한 후 복사본으로 retain/release 해야 함
+  * @param  None
+  * @retval 0: success, -1: 참조 count buffer 아님
+  */
+int em_event_arg_retain(em_event_arg_type *event)
+{
+    em_arg_normalize(event);
+    if((event == NULL) || (event->msg == NULL) || (event->storage != EM_ARG_STORAGE_REFCOUNT)) {
+        return -1;
+    }
+    __atomic_add_fetch(&EM_PAYLOAD_REF(event->msg)->refcnt, 1, __ATOMIC_RELAXED);
+    return 0;
+}
+
+/**
+  * @brief  em_event_arg_release
+  * @note   참조 count buffer는 참조 count 감소, 그 외는 EM_IS_MEMFREEREQUIRED()와 동일
+  * @param  None
+  * @retval None
+  */
+void em_event_arg_release(em_event_arg_type *event)
+{
+    if((event == NULL) || (event->msg == NULL)) {
+        return;
+    }
+    em_arg_normalize(event);
+    if(event->storage == EM_ARG_STORAGE_REFCOUNT) {
+        em_payload_ref_put(EM_PAYLOAD_REF(event->msg));
+        event->msg = NULL;
+        return;
+    }
+    EM_IS_MEMFREEREQUIRED(event);
+}
+
+/**
+  * @brief  em_event_trigger
+  * @note   Event trigger, 호출 thread에서 바로 dispatch.
+  *         dispatch context는 stack에 두므로 여러 thread(shard handler 포함)에서 동시 호출, handler 안에서 재호출 가능
+  * @param  None
+  * @retval None
+  */
+void em_event_trigger(em_group_name_type *eventgroup, int16_t signal, em_event_arg_type *event)
+{
+    em_dispatch_ctx_type ctx;
+
+    em_arg_normalize(event);
+
+    /* Search registered groupname */
+    int16_t group_index = get_registered_groupID(eventgroup);
+
+    if(group_index < 0) {
+        #ifdef PC_SIMULATION
+        printf("Group name(%s) is not registered!!!\n", eventgroup->name);
+        #else
+        DEBUGERR(GEN,"Group name(%s) is not registered!!!\n", eventgroup->name);
+        #endif  
+        return;
+    }
+
+    em_dispatch(&ctx, group_index, signal, event);
+}
+
+/**
+  * @brief  em_event_cache_enable
+  * @note   (group, signal) last value cache 사용. 이후 em_event_trigger()/em_event_post() 마다 update
+  * @param  max_len: 저장할 최대 payload 길이
+  * @retval 0: success, -1: error
+  */
+int em_event_cache_enable(em_group_name_type *eventgroup, int16_t signal, uint16_t max_len)
+{
+    em_event_id_type *evt;
+    em_last_value_type *last;
+    em_event_group_type *group = get_registered_group(eventgroup);
+
+    if((group == NULL) || (signal < 0)) {
+        return -1;
+    }
+    evt = getEventHandler(group, signal);
+    if(evt == NULL) {
+        return -1;
+    }
+    if(evt->last != NULL) {
+        return 0;
+    }
+
+    #ifdef PC_SIMULATION
+    last = (em_last_value_type *)malloc(sizeof(em_last_value_type) + max_len);
+    #else
+    last = (em_last_value_type *)pvPortMalloc(sizeof(em_last_value_type) + max_len);
+    #endif
+    if(last == NULL) {
+        #ifdef PC_SIMULATION
+        printf("Memory allocation error\n");
+        #else
+        DEBUGERR(GEN, AllocErrMsg("em_event_cache_enable"));
+        #endif  
+        return -1;
+    }
+    memset(last, 0x00, sizeof(em_last_value_type));
+    last->size = max_len;
+    evt->event = signal;
+
+    __atomic_store_n(&evt->last, last, __ATOMIC_RELEASE);
+    return 0;
+}
+
+/**
+  * @brief  em_get_last
+  * @note   lock 없이 last value 읽기, buf_len 보다 긴 값은 잘림
+  * @param  len: 복사 된 길이 (NULL argument로 trigger 된 경우 0)
+  * @retval 0: success, -1: cache 없음
+  */
+int em_get_last(em_group_name_type *eventgroup, int16_t signal, void *buf, uint16_t buf_len, uint16_t *len)
+{
+    em_event_id_type *evt;
+    em_last_value_type *last;
+    int16_t group_index = get_registered_groupID(eventgroup);
+
+    if((group_index < 0) || (signal < 0)) {
+        return -1;
+    }
+    evt = getEventHandler(&root_event_list.group[group_index], signal);
+    if(evt == NULL) {
+        return -1;
+    }
+    last = __atomic_load_n(&evt->last, __ATOMIC_ACQUIRE);
+    if(last == NULL) {
+        return -1;
+    }
+    return em_last_value_read(last, buf, buf_len, len, NULL);
+}
+
+/**
+  * @brief  em_event_post
+  * @note   group을 소유한 shard queue로 event 전달. global lock 없음 (shard queue lock만 사용)
+  *         event->msg 소유권은 event manager로 넘어감 (queue full로 -1 return 해도 event manager가 free).
+  *         const buffer는 dispatch 완료까지 유지 되어야 함.
+  *         shard dispatcher가 시작 되지 않은 경우 em_event_trigger()로 바로 처리
+  * @param  None
+  * @retval 0: success, -1: error
+  */
+int em_event_post(em_group_name_type *eventgroup, int16_t signal, em_event_arg_type *event)
+{
+    em_queue_item_type item;
+    em_event_group_type *group;
+    em_queue_type *queue;
+    uint16_t shard;
+    int ret;
+    int16_t group_index = get_registered_groupID(eventgroup);
+
+    em_arg_normalize(event);
+    if(group_index < 0) {
+        #ifdef PC_SIMULATION
+        printf("Group name(%s) is not registered!!!\n", eventgroup->name);
+        #else
+        DEBUGERR(GEN,"Group name(%s) is not registered!!!\n", eventgroup->name);
+        #endif  
+        return -1;
+    }
+
+    group = &root_event_list.group[group_index];
+    if((__atomic_load_n(&group->shard, __ATOMIC_ACQUIRE) == EM_SHARD_HOST) &&
+       __atomic_load_n(&em_host_ready, __ATOMIC_ACQUIRE)) {
+        shard = EM_SHARD_HOST;
+        queue = &em_host.queue;
+    }
+    else if(!em_shard_enter(group_index)) {
+        /* shard 없음 또는 시작/정지 중: inline 처리 */
+        em_event_trigger(eventgroup, signal, event);
+        return 0;
+    }
+    else {
+        shard = em_get_group_shard(group);
+        queue = &em_shard[shard].queue;
+    }
+    __atomic_fetch_add(&group->post_cnt, 1, __ATOMIC_RELAXED);
+
+    memset(&item, 0x00, sizeof(em_queue_item_type));
+    item.group_index = group_index;
+    item.signal = signal;
+    item.hasarg = (event != NULL) ? 1 : 0;
+    if(event != NULL) {
+        memcpy(&item.arg, event, sizeof(em_event_arg_type));
+    }
+
+    ret = em_queue_send(queue, &item);
+    if(shard != EM_SHARD_HOST) {
+        em_shard_leave(group_index);
+    }
+    if(ret < 0) {
+        #ifdef PC_SIMULATION
+        printf("Shard(%d) queue full, group(%s) event(0x%04x) dropped!!!\n", shard, eventgroup->name, signal);
+        #else
+        DEBUGERR(GEN,"Shard(%d) queue full, group(%s) event(0x%04x) dropped!!!\n", shard, eventgroup->name, signal);
+        #endif  
+        /* msg 소유권은 이미 넘어 왔으므로 drop 시 정리 (const buffer는 caller 소유) */
+        if((event != NULL) && ((event->isconst == 0) || (event->storage == EM_ARG_STORAGE_REFCOUNT))) {
+            em_payload_drop(event);
+        }
+        return -1;
+    }
+    return 0;
+}
 
-            #else
-                #ifdef PC_SIMULATION
-                em_event_id_type *evt_handler = (em_event_id_type *)malloc(sizeof(em_event_id_type));
-                #else
-                em_event_id_type *evt_handler = (em_event_id_type *)pvPortMalloc(sizeof(em_event_id_type));
-                #endif 
-                evt_handler->event = enum_event;
-                evt_handler->handler = NULL;
-                group->evthandler = evt_handler;
-                group->group_evt_cnt = 1;
-            #endif
-            root_event_list.group_cnt++;
+/**
+  * @brief  em_shard_start
+  * @note   shard dispatcher 생성, 각 dispatcher는 cpu_map[i] CPU에 고정
+  * @param  shard_count: 1 ~ MAX_EM_SHARD_COUNT
+  *         cpu_map: shard별 CPU 번호, NULL 이면 shard index % CPU 갯수
+  * @retval 0: success, -1: error
+  */
+int em_shard_start(uint16_t shard_count, const int16_t *cpu_map)
+{
+    uint16_t i;
+    uint8_t expected = 0;
+
+    if((shard_count == 0) || (shard_count > MAX_EM_SHARD_COUNT)) {
+        return -1;
+    }
+    if(!__atomic_compare_exchange_n(&em_shard_state, &expected, 1, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        return -1;
+    }
+
+    #ifdef PC_SIMULATION
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    #elif defined(configNUMBER_OF_CORES)
+    long ncpu = configNUMBER_OF_CORES;
+    #else
+    long ncpu = 1;
+    #endif
+
+    for(i = 0; i < shard_count; i++) {
+        int16_t cpu = cpu_map ? cpu_map[i] : (int16_t)(i % (ncpu > 0 ? ncpu : 1));
+        if(em_shard_create(&em_shard[i], cpu) < 0) {
+            break;
         }
-        else {
-            #if (FEATURE_SEQUENCE_EVENT_ENUM < 0)
-                /* GROUP이 이미 등록 되어 있음 */
+    }
 
-                /* Add event andler */
-                #ifdef PC_SIMULATION
-                em_event_id_type *evt_handler = (em_event_id_type *)malloc(sizeof(em_event_id_type));
-                #else
-                em_event_id_type *evt_handler = (em_event_id_type *)pvPortMalloc(sizeof(em_event_id_type));
-                #endif 
-                evt_handler->event = enum_event;
-                evt_handler->handler = NULL;
+    /* 일부만 생성 된 경우 생성된 shard만 사용 */
+    em_shard_count = i;
+    __atomic_store_n(&em_shard_state, (i > 0) ? 2 : 0, __ATOMIC_RELEASE);
 
-                addToTailEventList(&group->evthandler, evt_handler);
+    #ifdef PC_SIMULATION
+    printf("%d shard dispatcher started\n", em_shard_count);
+    #else
+    DEBUGHI(GEN,"%d shard dispatcher started\n", em_shard_count);
+    #endif
+    return (i == shard_count) ? 0 : -1;
+}
 
-                group->group_evt_cnt++;
-            #else
-                #ifdef PC_SIMULATION
-                printf("%s Group already registered!!!\n", eventgroup->name);
-                #else
-                DEBUGERR(GEN,"%s Group already registered!!!\n", eventgroup->name);
-                #endif                  
-            #endif
+/**
+  * @brief  em_shard_stop
+  * @note   queue에 남아 있는 event 처리 후 dispatcher, executor lane 종료.
+  *         stop 이후 em_event_post()는 em_event_trigger()로 처리 됨
+  * @param  None
+  * @retval None
+  */
+void em_shard_stop(void)
+{
+    uint16_t count;
+
+    /* 새 post는 inline 처리, queue 사용 중인 post 끝날 때 까지 대기 */
+    if(em_lane_quiesce(&em_shard_state, NULL)) {
+        for(uint16_t i = 0; i < MAX_EM_SHARD_COUNT; i++) {
+            em_lane_wait(&em_shard[i].users);
         }
+        count = em_shard_count;
+        for(uint16_t i = 0; i < count; i++) {
+            em_shard_destroy(&em_shard[i]);
+        }
+        em_shard_count = 0;
+        __atomic_store_n(&em_shard_state, 0, __ATOMIC_RELEASE);
     }
-    else {
-        /* group은 null이면 안됨 */
+
+    /* shard에서 offload 된 handler까지 처리 후 executor lane 종료 */
+    if(em_lane_quiesce(&em_executor_state, &em_executor_users)) {
+        em_shard_destroy(&em_executor);
+        __atomic_store_n(&em_executor_state, 0, __ATOMIC_RELEASE);
     }
 }
 
 /**
-  * @brief  em_event_trigger
-  * @note   Event trigger
+  * @brief  em_group_set_shard
+  * @note   group -> shard mapping 설정. EM_SHARD_AUTO 외에는 고정 (em_shard_rebalance() 에서 변경 하지 않음)
+  * @param  shard: 0 ~ MAX_EM_SHARD_COUNT-1, EM_SHARD_AUTO,
+  *         EM_SHARD_HOST (host event loop에서 em_dispatch_pending()으로 처리)
+  * @retval 0: success, -1: error
+  */
+int em_group_set_shard(em_group_name_type *eventgroup, int16_t shard)
+{
+    em_event_group_type *group = get_registered_group(eventgroup);
+
+    if((group == NULL) || (shard < EM_SHARD_AUTO) || (shard > EM_SHARD_HOST)) {
+        return -1;
+    }
+    if((shard == EM_SHARD_HOST) && (em_host_init() < 0)) {
+        return -1;
+    }
+    group->shard_pinned = (shard != EM_SHARD_AUTO) ? 1 : 0;
+    __atomic_store_n(&group->shard, shard, __ATOMIC_RELEASE);
+    return 0;
+}
+
+/**
+  * @brief  em_shard_rebalance
+  * @note   마지막 rebalance 이후 em_event_post() count 기준으로 group을 shard에 재배치
+  *         (post count가 큰 group 부터 load가 가장 작은 shard로). em_group_set_shard()로 고정 된 group(EM_SHARD_HOST 포함)은
+  *         제외 하고 고정 된 shard의 load로만 계산.
+  *         재배치 시점에 queue에 남아 있는 event는 이전 shard에서 처리 되므로
+  *         해당 group의 event 순서는 재배치 직후 보장 되지 않음.
   * @param  None
   * @retval None
   */
-void em_event_trigger(em_group_name_type *eventgroup, int16_t signal, em_event_arg_type *event)
+void em_shard_rebalance(void)
 {
-    /* move from stack to static */
-    // uint8_t *event_msg_backup = NULL;
-    // em_event_arg_type *current_event = NULL;
-    // em_event_group_type *group = NULL;
-    // em_handler_list_type *gListHandler = NULL;
-    // em_event_id_type *evt_handler = NULL;
-    // em_handler_list_type *eListHandler = NULL;
-    int16_t isbackupreq = -1;
+    uint32_t load[MAX_EM_SHARD_COUNT] = {0};
+    uint32_t post_cnt[MAX_ROOT_EVENT_GROUP_COUNT];
+    uint8_t done[MAX_ROOT_EVENT_GROUP_COUNT] = {0};
+    uint16_t count;
+    uint16_t grp_cnt = root_event_list.group_cnt;
 
-    /* Search registered groupname */
+    if(!em_shard_enter(0)) {
+        return;
+    }
+    count = em_shard_count;
+
+    for(uint16_t i = 0; i < grp_cnt; i++) {
+        post_cnt[i] = __atomic_exchange_n(&root_event_list.group[i].post_cnt, 0, __ATOMIC_RELAXED);
+        /* em_group_set_shard()로 고정 된 group, host event loop group은 재배치 하지 않음 */
+        if(root_event_list.group[i].shard_pinned || (root_event_list.group[i].shard == EM_SHARD_HOST)) {
+            done[i] = 1;
+            if((root_event_list.group[i].shard >= 0) && (root_event_list.group[i].shard < count)) {
+                load[root_event_list.group[i].shard] += post_cnt[i];
+            }
+        }
+    }
+
+    for(uint16_t n = 0; n < grp_cnt; n++) {
+        int16_t busiest = -1;
+        uint16_t target = 0;
+
+        for(uint16_t i = 0; i < grp_cnt; i++) {
+            if(!done[i] && ((busiest < 0) || (post_cnt[i] > post_cnt[busiest]))) {
+                busiest = i;
+            }
+        }
+        if(busiest < 0) {
+            break;
+        }
+        for(uint16_t s = 1; s < count; s++) {
+            if(load[s] < load[target]) {
+                target = s;
+            }
+        }
+        done[busiest] = 1;
+        load[target] += post_cnt[busiest];
+        __atomic_store_n(&root_event_list.group[busiest].shard, (int16_t)target, __ATOMIC_RELEASE);
+    }
+    em_shard_leave(0);
+}
+
+/**
+  * @brief  em_event_post_from_isr
+  * @note   ISR, POSIX signal handler에서 사용. memory 할당, print, list 접근 없이
+  *         미리 할당 된 ring에 inline payload로 기록만 함 (retry 제한, 실패 시 drop).
+  *         처리는 task context의 em_dispatch_isr_events() / em_dispatch_pending() 에서 수행
+  * @param  len: EM_INLINE_PAYLOAD_SIZE 이하
+  * @retval 0: success, -1: error (ring full 포함)
+  */
+int em_event_post_from_isr(em_group_name_type *eventgroup, int16_t signal, const void *data, uint16_t len)
+{
+    em_isr_slot_type *slot;
+    uint32_t pos;
     int16_t group_index = get_registered_groupID(eventgroup);
 
-    /* move from stack to static */
-    event_msg_backup = NULL;
-    current_event = NULL;
-    group = NULL;
-    gListHandler = NULL;
-    evt_handler = NULL;
-    eListHandler = NULL;
+    if((group_index < 0) || (len > EM_INLINE_PAYLOAD_SIZE) || ((data == NULL) && (len != 0))) {
+        __atomic_fetch_add(&em_isr_drop_cnt, 1, __ATOMIC_RELAXED);
+        return -1;
+    }
 
-    if(group_index < 0) {
-        #ifdef PC_SIMULATION
-        printf("Group name(%s) is not registered!!!\n", eventgroup->name);
-        #else
-        DEBUGERR(GEN,"Group name(%s) is not registered!!!\n", eventgroup->name);
-        #endif  
-        return;
+    slot = em_ring_reserve(em_isr_slot, sizeof(em_isr_slot_type), EM_ISR_RING_DEPTH, &em_isr_tail, EM_ISR_POST_RETRY, &pos);
+    if(slot == NULL) {
+        __atomic_fetch_add(&em_isr_drop_cnt, 1, __ATOMIC_RELAXED);
+        return -1;
     }
 
-    if(event != NULL) {
-        memcpy(&trigger_event, event, sizeof(em_event_arg_type));
-        current_event = &trigger_event;
+    slot->group_index = group_index;
+    slot->signal = signal;
+    slot->hasarg = (data != NULL) ? 1 : 0;
+    slot->arg.isconst = 1;
+    slot->arg.len = len;
+    slot->arg.msg = NULL;
+    slot->arg.storage = EM_ARG_STORAGE_INLINE;
+    if(len) {
+        memcpy(slot->arg.data, data, len);
+    }
+    __atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
 
-        #if (HANDLER_REQUIRED_MEMORYFREE > 0)
-        isbackupreq = is_event_backup_require(group_index, event, signal);
-        #else
-        /* memory free 는 event manager에서 수행 됨 */
-        current_event->isconst = 1;
-        #endif
+    /* wakeup은 drain 1회당 1번 */
+    #ifdef PC_SIMULATION
+    uint8_t expected = 0;
+    if(__atomic_load_n(&em_host_ready, __ATOMIC_ACQUIRE) &&
+       __atomic_compare_exchange_n(&em_isr_signalled, &expected, 1, 0, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+        uint64_t one = 1;
+        /* write()는 async-signal-safe */
+        if(write(em_host.queue.evfd, &one, sizeof(one)) < 0) {
+            __atomic_store_n(&em_isr_signalled, 0, __ATOMIC_RELAXED);
+        }
+    }
+    #else
+    uint8_t expected = 0;
+    if((em_isr_notify_task != NULL) &&
+       __atomic_compare_exchange_n(&em_isr_signalled, &expected, 1, 0, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+        BaseType_t woken = pdFALSE;
+        vTaskNotifyGiveFromISR(em_isr_notify_task, &woken);
+        portYIELD_FROM_ISR(woken);
     }
+    #endif
+    return 0;
+}
 
-    group = &root_event_list.group[group_index];
-    /* 1. Group handler 
-    */    
-    gListHandler = group->grphandler;
+/**
+  * @brief  em_isr_drain
+  * @note   ISR ring 처리. max_events 또는 budget_us 초과 시 중단
+  * @param  max_events: 0 이면 제한 없음, budget_us: 0 이면 제한 없음 (start 기준)
+  * @retval 처리한 event 수
+  */
+static int em_isr_drain(uint16_t max_events, uint32_t start, uint32_t budget_us)
+{
+    em_isr_slot_type *slot;
+    em_event_arg_type arg;
+    int16_t group_index, signal, hasarg;
+    int count = 0;
 
-    if(gListHandler != NULL) {
-        /* default handler */
-        #if (DEFAULT_HANDLER_NO_MEM_FREE > 0)
-        gListHandler->handler(eventgroup->name, signal, current_event);
-        gListHandler = gListHandler->pNext;
-        #endif
+    __atomic_store_n(&em_isr_signalled, 0, __ATOMIC_RELEASE);
+
+    while(((max_events == 0) || (count < max_events)) &&
+          ((budget_us == 0) || ((em_timestamp_us() - start) < budget_us))) {
+        slot = em_ring_peek(em_isr_slot, sizeof(em_isr_slot_type), EM_ISR_RING_DEPTH, em_isr_head);
+        if(slot == NULL) {
+            break;
+        }
+        /* slot은 바로 반환 (handler 수행 중 ISR post 가능 하도록) */
+        group_index = slot->group_index;
+        signal = slot->signal;
+        hasarg = slot->hasarg;
+        memcpy(&arg, &slot->arg, sizeof(em_event_arg_type));
+        __atomic_store_n(&slot->seq, em_isr_head + EM_ISR_RING_DEPTH, __ATOMIC_RELEASE);
+        em_isr_head++;
+
+        em_dispatch(&em_isr_ctx, group_index, signal, hasarg ? &arg : NULL);
+        count++;
+    }
+    return count;
+}
+
+/**
+  * @brief  em_dispatch_isr_events
+  * @note   em_event_post_from_isr() 로 post 된 event를 task context에서 처리.
+  *         한 task에서만 호출 해야 함 (em_dispatch_pending() 호출 task 포함)
+  * @param  max_events: 0 이면 제한 없음
+  * @retval 처리한 event 수
+  */
+int em_dispatch_isr_events(uint16_t max_events)
+{
+    return em_isr_drain(max_events, 0, 0);
+}
+
+#ifndef PC_SIMULATION
+/**
+  * @brief  em_set_isr_notify_task
+  * @note   em_event_post_from_isr() 후 task notify (vTaskNotifyGiveFromISR) 받을 task
+  *         해당 task는 ulTaskNotifyTake() 후 em_dispatch_isr_events() 호출
+  * @param  task: TaskHandle_t
+  * @retval None
+  */
+void em_set_isr_notify_task(void *task)
+{
+    em_isr_notify_task = (TaskHandle_t)task;
+}
+#endif
+
+/**
+  * @brief  em_get_event_fd
+  * @note   EM_SHARD_HOST group에 event가 post 되면 readable 되는 eventfd (epoll 등록용).
+  *         wakeup은 em_dispatch_pending() 1회당 1번
+  * @param  None
+  * @retval eventfd, -1: 지원 안함 (target은 em_dispatch_pending() polling)
+  */
+int em_get_event_fd(void)
+{
+    #ifdef PC_SIMULATION
+    if(em_host_init() < 0) {
+        return -1;
+    }
+    return em_host.queue.evfd;
+    #else
+    return -1;
+    #endif
+}
+
+/**
+  * @brief  em_dispatch_pending
+  * @note   host event loop thread에서 EM_SHARD_HOST group, em_event_post_from_isr() 의 pending event 처리.
+  *         host lane 초기화 전에도 ISR ring은 처리
+  *         max_events 또는 budget_us 초과 시 중단하고, 남은 event가 있으면 eventfd 다시 readable
+  * @param  max_events: 0 이면 제한 없음, budget_us: 0 이면 제한 없음
+  * @retval 처리한 event 수
+  */
+int em_dispatch_pending(uint16_t max_events, uint32_t budget_us)
+{
+    em_queue_item_type item;
+    uint32_t start = em_timestamp_us();
+    int count = 0;
+
+    /* host lane이 없어도 (em_get_event_fd() 호출 전) ISR에서 post 된 event는 처리 */
+    if(!__atomic_load_n(&em_host_ready, __ATOMIC_ACQUIRE)) {
+        return em_isr_drain(max_events, start, budget_us);
+    }
+
+    #ifdef PC_SIMULATION
+    /* read 후 signalled clear: clear 후 read 하면 그 사이 post의 wakeup이 지워짐 */
+    uint64_t value;
+    if(read(em_host.queue.evfd, &value, sizeof(value)) < 0) {
+        /* EAGAIN: 이미 clear 됨 */
+    }
+    pthread_mutex_lock(&em_host.queue.lock);
+    em_host.queue.signalled = 0;
+    pthread_mutex_unlock(&em_host.queue.lock);
+    #endif
+
+    /* ISR에서 post 된 event 먼저 처리 */
+    count = em_isr_drain(max_events, start, budget_us);
+
+    while(((max_events == 0) || (count < max_events)) &&
+          ((budget_us == 0) || ((em_timestamp_us() - start) < budget_us))) {
+        if(em_queue_try_receive(&em_host.queue, &item) < 0) {
+            break;
+        }
+        if(item.node != NULL) {
+            em_run_offloaded(&item);
+        }
+        else {
+            em_dispatch(&em_host.ctx, item.group_index, item.signal, item.hasarg ? &item.arg : NULL);
+        }
+        count++;
+    }
+
+    #ifdef PC_SIMULATION
+    /* 남은 event가 있으면 다음 loop에서 다시 호출 되도록 */
+    int wakeup = 0;
+    pthread_mutex_lock(&em_host.queue.lock);
+    if(((em_host.queue.count > 0) || em_ring_peek(em_isr_slot, sizeof(em_isr_slot_type), EM_ISR_RING_DEPTH, em_isr_head)) &&
+       !em_host.queue.signalled) {
+        em_host.queue.signalled = 1;
+        wakeup = 1;
+    }
+    pthread_mutex_unlock(&em_host.queue.lock);
+    if(wakeup) {
+        value = 1;
+        if(write(em_host.queue.evfd, &value, sizeof(value)) != sizeof(value)) {
+            printf("eventfd write error\n");
+        }
+    }
+    #endif
+    return count;
+}
+
+/**
+  * @brief  em_set_handler_budget
+  * @note   handler 실행 시간 budget 설정, 0 이면 측정 안함.
+  *         executor lane으로 이동 된 handler는 다시 inline 수행으로 복귀
+  * @param  None
+  * @retval 0: success, -1: handler 등록 되지 않음
+  */
+int em_set_handler_budget(em_group_name_type *eventgroup, int16_t signal, evt_handler_fp handler, uint32_t budget_us)
+{
+    em_handler_list_type *node = em_find_handler_node(eventgroup, signal, handler);
+
+    if(node == NULL) {
+        return -1;
+    }
+    node->budget_us = budget_us;
+    node->overrun_seq = 0;
+    node->offloaded = 0;
+    return 0;
+}
+
+/**
+  * @brief  em_get_handler_stats
+  * @note   handler 실행 시간 통계 (executor lane 수행은 call_cnt에 포함 안됨)
+  * @param  None
+  * @retval 0: success, -1: handler 등록 되지 않음
+  */
+int em_get_handler_stats(em_group_name_type *eventgroup, int16_t signal, evt_handler_fp handler, em_handler_stats_type *stats)
+{
+    em_handler_list_type *node = em_find_handler_node(eventgroup, signal, handler);
+
+    if((node == NULL) || (stats == NULL)) {
+        return -1;
+    }
+    stats->budget_us = node->budget_us;
+    stats->max_us = node->max_us;
+    stats->call_cnt = node->call_cnt;
+    stats->overrun_cnt = node->overrun_cnt;
+    stats->offloaded = node->offloaded;
+    stats->drop_cnt = node->drop_cnt;
+    return 0;
+}
+
+/**
+  * @brief  em_set_slow_handler_callback
+  * @note   handler가 executor lane으로 이동 될 때 호출 (dispatch context)
+  * @param  None
+  * @retval None
+  */
+void em_set_slow_handler_callback(em_slow_handler_fp callback)
+{
+    em_slow_handler_cb = callback;
+}
+
+/**
+  * @brief  em_memory_report
+  * @note   event manager가 사용 중인 memory (heap 할당 + group table)
+  * @param  report: NULL 이면 출력만
+  * @retval None
+  */
+void em_memory_report(em_memory_report_type *report)
+{
+    em_memory_report_type r;
+    em_event_group_type *group;
+    em_event_id_type *evt;
+    em_handler_list_type *node;
+    uint32_t handler_cnt = 0;
+
+    memset(&r, 0x00, sizeof(em_memory_report_type));
+    r.group_bytes = sizeof(em_event_group_list_type) + em_fanout_retired_bytes;
 
-        while (gListHandler != NULL) {
-            if(isbackupreq > 0) {
-                event_msg_backup = em_NewEventMem(current_event);
+    for(uint16_t g = 0; g < root_event_list.group_cnt; g++) {
+        group = &root_event_list.group[g];
+        if(group->fanout) {
+            r.group_bytes += sizeof(em_fanout_type) + sizeof(em_handler_list_type *) * group->fanout->cnt;
+        }
+        r.event_bytes += sizeof(em_event_id_type) * group->group_evt_cnt;
+        r.event_bytes += sizeof(em_event_id_type *) * group->evt_hash_size;
+        r.handler_bytes += sizeof(em_handler_list_type *) * group->grpindex.set_size;
+
+        for(node = group->grphandler; node != NULL; node = node->pNext) {
+            handler_cnt++;
+        }
+        for(evt = group->evthandler; evt != NULL; evt = evt->pNext) {
+            if(evt->last) {
+                r.event_bytes += sizeof(em_last_value_type) + evt->last->size;
+            }
+            r.handler_bytes += sizeof(em_handler_list_type *) * evt->index.set_size;
+            for(node = evt->handler; node != NULL; node = node->pNext) {
+                handler_cnt++;
             }
-            gListHandler->handler(eventgroup->name, signal, current_event);
-            gListHandler = gListHandler->pNext;
+        }
+    }
+    r.handler_bytes += sizeof(em_handler_list_type) * handler_cnt;
+    for(uint16_t i = 0; i < EM_PAYLOAD_STAT_STRIPES; i++) {
+        r.payload_cnt += __atomic_load_n(&em_payload_stat[i].cnt, __ATOMIC_RELAXED);
+        r.payload_bytes += __atomic_load_n(&em_payload_stat[i].bytes, __ATOMIC_RELAXED);
+    }
+    r.arena_bytes = em_arena_size;
+
+    if(em_shard_enter(0)) {
+        for(uint16_t i = 0; i < em_shard_count; i++) {
+            r.queued_cnt += em_queue_pending(&em_shard[i].queue, &r.queued_bytes);
+        }
+        em_shard_leave(0);
+    }
+    if(em_host_ready) {
+        r.queued_cnt += em_queue_pending(&em_host.queue, &r.queued_bytes);
+    }
+    if(em_lane_enter(&em_executor_state, &em_executor_users)) {
+        r.queued_cnt += em_queue_pending(&em_executor.queue, &r.queued_bytes);
+        em_lane_leave(&em_executor_users);
+    }
+    r.queued_cnt += __atomic_load_n(&em_isr_tail, __ATOMIC_ACQUIRE) - em_isr_head;
+
+    r.total_bytes = r.group_bytes + r.event_bytes + r.handler_bytes + r.payload_bytes + r.queued_bytes;
+
+    #ifdef PC_SIMULATION
+    printf("\n============ MEMORY REPORT ============\n");
+    printf("groups   : %u bytes (%u groups)\n", r.group_bytes, root_event_list.group_cnt);
+    printf("events   : %u bytes\n", r.event_bytes);
+    printf("handlers : %u bytes (%u nodes)\n", r.handler_bytes, handler_cnt);
+    printf("payloads : %u bytes (%u pending, %u queued events)\n", r.payload_bytes, r.payload_cnt, r.queued_cnt);
+    printf("queued   : %u bytes (heap msg)\n", r.queued_bytes);
+    printf("arena    : %u bytes\n", r.arena_bytes);
+    printf("total    : %u bytes\n", r.total_bytes);
+    printf("=======================================\n");
+    #else
+    DEBUGHI(GEN,"groups   : %u bytes (%u groups)\n", r.group_bytes, root_event_list.group_cnt);
+    DEBUGHI(GEN,"events   : %u bytes\n", r.event_bytes);
+    DEBUGHI(GEN,"handlers : %u bytes (%u nodes)\n", r.handler_bytes, handler_cnt);
+    DEBUGHI(GEN,"payloads : %u bytes (%u pending, %u queued events)\n", r.payload_bytes, r.payload_cnt, r.queued_cnt);
+    DEBUGHI(GEN,"queued   : %u bytes (heap msg)\n", r.queued_bytes);
+    DEBUGHI(GEN,"arena    : %u bytes\n", r.arena_bytes);
+    DEBUGHI(GEN,"total    : %u bytes\n", r.total_bytes);
+    #endif
+
+    if(report) {
+        memcpy(report, &r, sizeof(em_memory_report_type));
+    }
+}
+
+/**
+  * @brief  em_compact
+  * @note   모든 event entry, handler node를 하나의 arena로 옮김.
+  *         group별로 group handler -> event entry array -> event handler 순서 (dispatch 순서).
+  *         hash index, parent fan-out array는 다시 계산.
+  *         dispatch 중이면 안됨 (em_shard_stop() 이후, host queue 비어 있을 때 호출)
+  * @param  None
+  * @retval 0: success, -1: error (동작 중인 dispatcher 있음 또는 memory allocation error)
+  */
+int em_compact(void)
+{
+    em_event_group_type *group;
+    em_event_id_type *evt, *next, *new_evt, *old_dense;
+    em_handler_list_type *node;
+    uint8_t *arena, *pos;
+    uint8_t *old_arena = em_arena;
+    uint32_t size = 0;
+    uint16_t g, i, evt_cnt;
+
+    if(!em_is_quiescent()) {
+        #ifdef PC_SIMULATION
+        printf("em_compact: dispatcher is running!!!\n");
+        #else
+        DEBUGERR(GEN,"em_compact: dispatcher is running!!!\n");
+        #endif                  
+        return -1;
+    }
 
-            if(event_msg_backup != NULL) {
-                current_event->msg = event_msg_backup;
+    /* 1. arena size */
+    for(g = 0; g < root_event_list.group_cnt; g++) {
+        group = &root_event_list.group[g];
+        for(node = group->grphandler; node != NULL; node = node->pNext) {
+            size += sizeof(em_handler_list_type);
+        }
+        for(evt = group->evthandler; evt != NULL; evt = evt->pNext) {
+            size += sizeof(em_event_id_type);
+            for(node = evt->handler; node != NULL; node = node->pNext) {
+                size += sizeof(em_handler_list_type);
             }
         }
     }
+    if(size == 0) {
+        return 0;
+    }
 
-    /* isbackupreq > 0 일 경우  1개의 event_msg_backup 남아 있음 
-       current_event->msg에 내용이 있음.
-    */
+    #ifdef PC_SIMULATION
+    arena = (uint8_t *)malloc(size);
+    #else
+    arena = (uint8_t *)pvPortMalloc(size);
+    #endif 
+    if(arena == NULL) {
+        #ifdef PC_SIMULATION
+        printf("Memory allocation error\n");
+        #else
+        DEBUGERR(GEN, AllocErrMsg("em_compact"));
+        #endif  
+        return -1;
+    }
 
-    /* 2. Event handler 
-    */    
-    evt_handler = getEventHandler(group, signal);
-    eListHandler = evt_handler->handler;
-    while (eListHandler != NULL) {
-        if(isbackupreq > 0) {
-            event_msg_backup = em_NewEventMem(current_event);
+    /* 2. dispatch 순서로 복사, 이전 node free (이전 arena 안의 node는 마지막에 한번에) */
+    pos = arena;
+    for(g = 0; g < root_event_list.group_cnt; g++) {
+        group = &root_event_list.group[g];
+        group->grphandler = em_compact_list(group->grphandler, &pos);
+        em_handler_index_rebuild(&group->grpindex, group->grphandler);
+
+        new_evt = (em_event_id_type *)pos;
+        old_dense = (group->attr.lookup == EM_LOOKUP_DENSE) ? group->evthandler : NULL;
+        evt_cnt = 0;
+        for(evt = group->evthandler; evt != NULL; evt = next) {
+            next = evt->pNext;
+            memcpy(&new_evt[evt_cnt], evt, sizeof(em_event_id_type));
+            new_evt[evt_cnt].pNext = (next != NULL) ? &new_evt[evt_cnt + 1] : NULL;
+            evt_cnt++;
+            /* EM_LOOKUP_HASH: event entry 별로 할당 됨 */
+            if(old_dense == NULL) {
+                em_arena_free(evt);
+            }
+        }
+        /* EM_LOOKUP_DENSE: array 한번에 할당 됨 */
+        em_arena_free(old_dense);
+        pos += sizeof(em_event_id_type) * evt_cnt;
+
+        for(i = 0; i < evt_cnt; i++) {
+            new_evt[i].handler = em_compact_list(new_evt[i].handler, &pos);
+            em_handler_index_rebuild(&new_evt[i].index, new_evt[i].handler);
         }
-        eListHandler->handler(eventgroup->name, signal, current_event);
-        eListHandler = eListHandler->pNext;
+        group->evthandler = (evt_cnt > 0) ? new_evt : NULL;
 
-        if(event_msg_backup != NULL) {
-            current_event->msg = event_msg_backup;
+        /* hash index 다시 구성 (size 변화 없음) */
+        if(group->evt_hash) {
+            memset(group->evt_hash, 0x00, sizeof(em_event_id_type *) * group->evt_hash_size);
+            for(i = 0; i < evt_cnt; i++) {
+                *em_evt_hash_slot(group->evt_hash, group->evt_hash_size, new_evt[i].event) = &new_evt[i];
+            }
         }
     }
-    /* isbackupreq > 0 일 경우  1개의 event_msg_backup 남아 있음 */
-    if(event_msg_backup) {
+
+    em_arena = arena;
+    em_arena_size = size;
+    if(old_arena) {
         #ifdef PC_SIMULATION
-        free(event_msg_backup);
+        free(old_arena);
         #else
-        vPortFree(event_msg_backup);
+        vPortFree(old_arena);
         #endif 
     }
 
-    #if (HANDLER_REQUIRED_MEMORYFREE <= 0)
-    EM_IS_MEMFREEREQUIRED(event);
-    #endif
+    /* 3. parent fan-out array는 이전 node를 가리킴 */
+    for(g = 0; g < root_event_list.group_cnt; g++) {
+        em_group_build_fanout(&root_event_list.group[g]);
+    }
+    return 0;
 }
 
 /**
@@ -560,8 +3350,17 @@ void em_initialize(void)
 {
     memset(&root_event_list, 0x00, sizeof(em_event_group_list_type));
 
+    for(uint32_t i = 0; i < EM_ISR_RING_DEPTH; i++) {
+        em_isr_slot[i].seq = i;
+    }
+    em_isr_head = 0;
+    em_isr_tail = 0;
+
     for(int i=0; i<MAX_ROOT_EVENT_GROUP_COUNT; i++ ) {
         root_event_list.group[i].event_group.gid = -1;
+        root_event_list.group[i].parent = -1;
+        root_event_list.group[i].shard = EM_SHARD_AUTO;
+        root_event_list.group[i].shard_pinned = 0;
     }
 
     //memory allocation error
@@ -569,6 +3368,8 @@ void em_initialize(void)
     printf("\n============ DEFINITIONS ==============\n");
     printf("PC_SIMULATION is ON\n");
     printf("MAX_ROOT_EVENT_GROUP_COUNT is %d\n", MAX_ROOT_EVENT_GROUP_COUNT);
+    printf("MAX_EM_SHARD_COUNT is %d\n", MAX_EM_SHARD_COUNT);
+    printf("EM_DEFAULT_HANDLER_BUDGET_US is %d\n", EM_DEFAULT_HANDLER_BUDGET_US);
     printf("DEFAULT_HANDLER_NO_MEM_FREE is %s\n", DEFAULT_HANDLER_NO_MEM_FREE > 0 ? "ON":"OFF");
     printf("HANDLER_REQUIRED_MEMORYFREE is %s\n", HANDLER_REQUIRED_MEMORYFREE > 0 ? "ON":"OFF");
     printf("FEATURE_SEQUENCE_EVENT_ENUM is %s\n", FEATURE_SEQUENCE_EVENT_ENUM > 0 ? "ON":"OFF");
@@ -577,6 +3378,8 @@ void em_initialize(void)
     #else
     DEBUGHI(GEN,"PC_SIMULATION is OFF\n")
     DEBUGHI(GEN,"MAX_ROOT_EVENT_GROUP_COUNT is %d\n", MAX_ROOT_EVENT_GROUP_COUNT);
+    DEBUGHI(GEN,"MAX_EM_SHARD_COUNT is %d\n", MAX_EM_SHARD_COUNT);
+    DEBUGHI(GEN,"EM_DEFAULT_HANDLER_BUDGET_US is %d\n", EM_DEFAULT_HANDLER_BUDGET_US);
     DEBUGHI(GEN,"DEFAULT_HANDLER_NO_MEM_FREE is %s\n", DEFAULT_HANDLER_NO_MEM_FREE > 0 ? "ON":"OFF");
     DEBUGHI(GEN,"HANDLER_REQUIRED_MEMORYFREE is %s\n", HANDLER_REQUIRED_MEMORYFREE > 0 ? "ON":"OFF");
     DEBUGHI(GEN,"FEATURE_SEQUENCE_EVENT_ENUM is %s\n", FEATURE_SEQUENCE_EVENT_ENUM > 0 ? "ON":"OFF");
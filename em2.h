@@ -23,6 +23,7 @@
 /* Includes ------------------------------------------------------------------*/
 /* standard includes */
 #include <stdint.h>
+#include <string.h>
 
 /* scheduler includes */
 /* driver includes */
@@ -31,25 +32,64 @@
 /* Private defines -----------------------------------------------------------*/
 #define PC_SIMULATION
 
+/* 아래 3개는 em_events_register() 로 등록 되는 group의 기본 attribute.
+   group별로 다르게 사용 하려면 em_events_register_ex() 사용 (em_group_attr_type)
+*/
+
+/* 1: default handler에서 memory free 하지 않음 (default_handler_free = 0) */
 #define DEFAULT_HANDLER_NO_MEM_FREE             (1)
 
-/* 1: handler function에서 memory free 수행 해야 함
-  -1: event manager에서 memory free 수행 함.
+/* 1: handler function에서 memory free 수행 해야 함 (EM_PAYLOAD_COPY)
+  -1: event manager에서 memory free 수행 함. (EM_PAYLOAD_BORROW)
 */
 #define HANDLER_REQUIRED_MEMORYFREE             (-1)
 
-/* 1: 각 group별 event enum이 0 부터 시작 해서 순서 대로 되어 있어 event갯수로 한꺼번에 register 됨
-  -1: 각 group별 event enum이 연속적이이 않아서 event별로 register해야 함.
+/* 1: 각 group별 event enum이 0 부터 시작 해서 순서 대로 되어 있어 event갯수로 한꺼번에 register 됨 (EM_LOOKUP_DENSE)
+  -1: 각 group별 event enum이 연속적이이 않아서 event별로 register해야 함. (EM_LOOKUP_HASH)
 */
 #define FEATURE_SEQUENCE_EVENT_ENUM             (1)
 
 /* Exported constants --------------------------------------------------------*/
 #define MAX_ROOT_EVENT_GROUP_COUNT              20
 
+/* em_event_arg_set(): 이 크기 이하 payload는 heap 없이 em_event_arg_type 안에 저장 */
+#define EM_INLINE_PAYLOAD_SIZE                  32
+
+/* shard dispatcher: 각 shard는 group 일부, 자체 queue, 자체 dispatcher thread(task)를 가진다. */
+#define MAX_EM_SHARD_COUNT                      4
+#define EM_SHARD_QUEUE_DEPTH                    32
+#define EM_SHARD_AUTO                           (-1)    /* gid % shard count */
+#define EM_SHARD_HOST                           (MAX_EM_SHARD_COUNT)    /* host event loop, em_dispatch_pending() */
+
+/* em_on_event_ex() flags */
+#define EM_SUBSCRIBE_STICKY                     (0x0001)    /* 등록 즉시 last value 전달 */
+#define EM_SUBSCRIBE_REFCOUNT                   (0x0002)    /* 중복 구독은 참조 count 증가 (기본: reject) */
+
+/* em_get_last(): writer update 중일 때 retry 횟수 */
+#define EM_LAST_VALUE_READ_RETRY                16
+
+/* handler 실행 시간 budget: 연속 EM_SLOW_HANDLER_OFFLOAD_COUNT 회 초과 시 executor lane으로 이동 */
+#define EM_DEFAULT_HANDLER_BUDGET_US            5000
+#define EM_SLOW_HANDLER_OFFLOAD_COUNT           3
+
+/* em_event_post_from_isr(): 미리 할당 된 ring (2^n), slot 확보 retry 횟수 (초과 시 drop) */
+#define EM_ISR_RING_DEPTH                       64
+#define EM_ISR_POST_RETRY                       4
+
+/* local signal : task 자체      0x0000 ~ 0x7FFF
+   global signal: event manager 0x8000 ~ 0xFFFF (mailbox 전달 시 자동으로 설정) */
+#define EM_GLOBAL_SIGNAL_FLAG                   (0x8000)
+#define EM_IS_GLOBAL_SIGNAL(sig)                (((uint16_t)(sig) & EM_GLOBAL_SIGNAL_FLAG) != 0)
+
+#ifndef PC_SIMULATION
+#define EM_SHARD_TASK_STACK_SIZE                (configMINIMAL_STACK_SIZE * 4)
+#define EM_SHARD_TASK_PRIORITY                  (tskIDLE_PRIORITY + 2)
+#endif
+
 /* Exported macro ------------------------------------------------------------*/
 #ifdef PC_SIMULATION
 #define EM_IS_MEMFREEREQUIRED(ev)                \
-    if ((ev) && (ev->msg != NULL) && (ev->isconst == 0)) \
+    if ((ev) && (ev->msg != NULL) && (ev->isconst == 0) && !EM_ARG_IS_REFCOUNT(ev) && !EM_ARG_IS_INLINE(ev)) \
     {                                            \
         free(ev->msg);                           \
         ev->msg = NULL;                          \
@@ -57,21 +97,64 @@
     }
 #else
 #define EM_IS_MEMFREEREQUIRED(ev)                \
-    if ((ev) && (ev->msg != NULL) && (ev->isconst == 0)) \
+    if ((ev) && (ev->msg != NULL) && (ev->isconst == 0) && !EM_ARG_IS_REFCOUNT(ev) && !EM_ARG_IS_INLINE(ev)) \
     {                                            \
         vPortFree(ev->msg);                      \
         ev->msg = NULL;                          \
     }
 #endif 
 
+/* storage 판별: tag 값과 함께 확인 값이 맞아야 함. 초기화 안된 argument(기존 {isconst, len, msg} 사용)는 heap/const로 처리
+   EM_ARG_STORAGE_INLINE  : msg가 자신의 data를 가리킴
+   EM_ARG_STORAGE_REFCOUNT: data에 msg pointer 복사본 */
+#define EM_ARG_IS_INLINE(ev)                     \
+    (((ev)->storage == EM_ARG_STORAGE_INLINE) && ((ev)->msg == (void *)(ev)->data))
+#define EM_ARG_IS_REFCOUNT(ev)                   \
+    (((ev)->storage == EM_ARG_STORAGE_REFCOUNT) && ((ev)->msg != NULL) && \
+     (memcmp((ev)->data, &(ev)->msg, sizeof(void *)) == 0))
+
+/* inline payload의 data pointer. em_event_arg_type을 복사 한 경우 msg 대신 사용 */
+#define EM_EVENT_ARG_DATA(ev)                    \
+    (((ev)->storage == EM_ARG_STORAGE_INLINE) ? (void *)(ev)->data : (ev)->msg)
+
 /* Exported types ------------------------------------------------------------*/
+/* em_event_arg_type storage */
+/* em_event_arg_set()이 설정, 그 외 값은 모두 HEAP으로 처리 (초기화 안된 argument 호환) */
+#define EM_ARG_STORAGE_HEAP                     (0)         /* malloc buffer 또는 const buffer */
+#define EM_ARG_STORAGE_REFCOUNT                 (0x5243)    /* event manager 참조 count buffer ('RC') */
+#define EM_ARG_STORAGE_INLINE                   (0x494E)    /* data[] 에 값으로 저장, free 필요 없음 ('IN') */
+
 typedef struct
 {
     uint16_t    isconst;
     uint16_t    len;
-    void *      msg;
+    void *      msg;        // EM_ARG_STORAGE_INLINE: event manager가 data를 가리키도록 설정
+    uint16_t    storage;    // EM_ARG_STORAGE_xxx, em_event_arg_set() 으로만 설정
+    uint8_t     data[EM_INLINE_PAYLOAD_SIZE];
 } em_event_arg_type;
 
+/* group event lookup 방법 */
+typedef enum
+{
+    EM_LOOKUP_DENSE = 0,    /* event enum 0 ~ (count-1), array index */
+    EM_LOOKUP_HASH,         /* 비연속 event enum, event별 register, hash index */
+} em_lookup_policy_type;
+
+/* group payload memory 소유 방법 */
+typedef enum
+{
+    EM_PAYLOAD_BORROW = 0,  /* handler는 빌려 쓰고 event manager에서 free */
+    EM_PAYLOAD_COPY,        /* handler별 복사본 전달, handler에서 free */
+    EM_PAYLOAD_REFCOUNT,    /* 참조 count buffer 공유, 보관 시 em_event_arg_retain()/em_event_arg_release() */
+} em_payload_policy_type;
+
+typedef struct
+{
+    uint8_t     lookup;                 // em_lookup_policy_type
+    uint8_t     payload;                // em_payload_policy_type
+    uint8_t     default_handler_free;   // 1: default handler도 다른 handler 처럼 memory free
+} em_group_attr_type;
+
 typedef struct 
 {
     const char  *name;
@@ -80,28 +163,141 @@ typedef struct
 
 typedef void (*evt_handler_fp)(const char*, int16_t, em_event_arg_type *);
 
+/* mailbox item: 소유 task에서 처리 후 em_event_arg_release(&item.arg) 해야 함 */
+typedef struct
+{
+    const char              *groupname;
+    uint16_t                signal;     // signal | EM_GLOBAL_SIGNAL_FLAG
+    uint16_t                hasarg;
+    em_event_arg_type       arg;
+} em_mailbox_item_type;
+
+typedef struct
+{
+    uint32_t                seq;
+    em_mailbox_item_type    item;
+} em_mailbox_slot_type;
+
+struct sEM_MAILBOX_T;
+typedef void (*em_mailbox_notify_fp)(struct sEM_MAILBOX_T *, void *);
+
+/* lock-free MPSC ring (producer: dispatcher 들, consumer: 소유 task 1개) */
+typedef struct sEM_MAILBOX_T
+{
+    em_mailbox_slot_type    *slot;
+    uint16_t                depth;      // 2^n
+    uint32_t                head;       // consumer
+    uint32_t                tail;       // producers
+    uint32_t                drop_cnt;   // mailbox full
+    em_mailbox_notify_fp    notify;     // post 후 호출 (task notify, semaphore 등)
+    void                    *notify_arg;
+} em_mailbox_type;
+
 typedef struct sEM_HANDLER_T
 {
     evt_handler_fp          handler;
     struct sEM_HANDLER_T    *pNext;
+    em_mailbox_type         *mailbox;       // NULL 아니면 handler 대신 mailbox로 전달
+    uint32_t                budget_us;      // 0: 측정 안함
+    uint32_t                max_us;
+    uint32_t                call_cnt;
+    uint32_t                overrun_cnt;    // 누적 budget 초과 횟수
+    uint16_t                overrun_seq;    // 연속 budget 초과 횟수
+    uint16_t                offloaded;      // 1: executor lane에서 수행
+    uint16_t                sub_cnt;        // 구독 횟수 (EM_SUBSCRIBE_REFCOUNT 중복 구독 시 증가)
+    uint32_t                drop_cnt;       // offload 실패 (executor queue full) 로 drop 된 event
 } em_handler_list_type;
 
+/* handler list tail, 중복 검사용 hash set (key: handler 또는 mailbox) */
+typedef struct
+{
+    em_handler_list_type    *tail;
+    em_handler_list_type    **set;          // open addressing
+    uint16_t                set_size;
+    uint16_t                cnt;
+} em_handler_index_type;
+
+/* em_on_events_bulk() item */
+typedef struct
+{
+    em_group_name_type      *eventgroup;
+    int16_t                 signal;
+    evt_handler_fp          handler;
+    uint16_t                flags;          // em_on_event_ex() flags
+} em_subscription_type;
+
+typedef struct
+{
+    uint32_t                budget_us;
+    uint32_t                max_us;
+    uint32_t                call_cnt;
+    uint32_t                overrun_cnt;
+    uint16_t                offloaded;
+    uint32_t                drop_cnt;       // executor queue full 로 drop 된 event
+} em_handler_stats_type;
+
+typedef void (*em_slow_handler_fp)(const char *, int16_t, evt_handler_fp, uint32_t elapsed_us);
+
+/* em_memory_report() 결과 (byte) */
+typedef struct
+{
+    uint32_t                group_bytes;    // group table, parent fan-out array
+    uint32_t                event_bytes;    // event entry, hash index, last value cache
+    uint32_t                handler_bytes;  // handler node, 중복 검사 hash set
+    uint32_t                payload_bytes;  // 살아 있는 참조 count payload
+    uint32_t                payload_cnt;
+    uint32_t                queued_cnt;     // shard/host/executor queue, ISR ring 대기 event
+    uint32_t                queued_bytes;   // queue 대기 event가 가지고 있는 heap msg (참조 count payload 제외)
+    uint32_t                arena_bytes;    // em_compact() arena (event, handler bytes에 포함)
+    uint32_t                total_bytes;
+} em_memory_report_type;
+
+/* (group, signal) last value cache, seqlock 으로 보호 */
+typedef struct
+{
+    uint32_t                seq;        // 홀수: update 중
+    uint16_t                valid;      // 1: cache 된 값 있음
+    uint16_t                hasarg;     // 0: NULL argument로 trigger 됨
+    uint16_t                len;
+    uint16_t                size;       // data buffer size
+    uint8_t                 data[];
+} em_last_value_type;
+
 typedef struct sEM_ID_HANDLER_T
 {
     int16_t                 event;
     uint16_t                event_id;
     em_handler_list_type    *handler;
-    #ifndef FEATURE_NONSEQ_ENUM 
-    struct sEM_ID_HANDLER_T *pNext;
-    #endif
+    em_handler_index_type   index;      // handler list tail, hash set
+    em_last_value_type      *last;      // NULL: cache 사용 안함
+    struct sEM_ID_HANDLER_T *pNext;     // 등록 순서 list (dense group도 array 순서로 연결)
 } em_event_id_type;
 
+/* parent group handler fan-out (group 자신 또는 가까운 parent에 이미 있는 handler는 제외) */
+typedef struct sEM_FANOUT_T
+{
+    struct sEM_FANOUT_T     *retired_next;  // 교체 후 읽는 dispatcher가 없을 때 까지 보관
+    int16_t                 group_index;    // 소유 group (retired array free 시 fanout_readers 확인)
+    uint16_t                cnt;
+    em_handler_list_type    *node[];
+} em_fanout_type;
+
 typedef struct 
 {
     em_group_name_type      event_group;
     em_handler_list_type    *grphandler; // Group handler
+    em_handler_index_type   grpindex;
     em_event_id_type        *evthandler;
     uint16_t                group_evt_cnt;
+    em_group_attr_type      attr;
+    em_event_id_type        **evt_hash;     // EM_LOOKUP_HASH index (open addressing)
+    uint16_t                evt_hash_size;
+    int16_t                 parent;         // parent group index, -1: root
+    struct sEM_FANOUT_T     *fanout;        // parent 쪽 group handler (subscription 변경 시 계산), atomic publish
+    uint32_t                fanout_readers; // fanout 읽는 중인 dispatch 수 (retired array grace period)
+    int16_t                 shard;          // owning shard, EM_SHARD_AUTO by default
+    uint32_t                post_cnt;       // em_event_post() count since last rebalance
+    uint8_t                 shard_pinned;   // em_group_set_shard()로 지정, em_shard_rebalance() 에서 제외
 } em_event_group_type;
 
 typedef struct 
@@ -130,15 +326,75 @@ typedef struct
 
 /* Event request */
 void em_on_event(em_group_name_type *eventgroup, int16_t signal, evt_handler_fp handler);
+void em_on_event_ex(em_group_name_type *eventgroup, int16_t signal, evt_handler_fp handler, uint16_t flags);
+int em_on_events_bulk(const em_subscription_type *subs, uint16_t count);
+
+/*---------------------------------------------*/
+/* Mailbox */
+int em_mailbox_init(em_mailbox_type *mailbox, em_mailbox_slot_type *slot, uint16_t depth);
+void em_mailbox_set_notify(em_mailbox_type *mailbox, em_mailbox_notify_fp notify, void *arg);
+void em_on_event_mailbox(em_group_name_type *eventgroup, int16_t signal, em_mailbox_type *mailbox);
+uint16_t em_mailbox_drain(em_mailbox_type *mailbox, em_mailbox_item_type *item, uint16_t max_items);
 
 /*---------------------------------------------*/
 /* Event register */
 void em_events_register(em_group_name_type *, int16_t );
+int em_events_register_ex(em_group_name_type *eventgroup, int16_t event, const em_group_attr_type *attr);
+
+/*---------------------------------------------*/
+/* Event argument */
+int em_event_arg_set(em_event_arg_type *event, const void *data, uint16_t len);
+int em_event_arg_retain(em_event_arg_type *event);
+void em_event_arg_release(em_event_arg_type *event);
+
+/*---------------------------------------------*/
+/* Group hierarchy: parent group 전체 event(signal < 0) 구독자는 child group event도 받음 */
+int em_group_set_parent(em_group_name_type *eventgroup, em_group_name_type *parentgroup);
 
 /*---------------------------------------------*/
 /* Event trigger */
 void em_event_trigger(em_group_name_type *eventgroup, int16_t signal, em_event_arg_type *event);
 
+/*---------------------------------------------*/
+/* Last value cache */
+int em_event_cache_enable(em_group_name_type *eventgroup, int16_t signal, uint16_t max_len);
+int em_get_last(em_group_name_type *eventgroup, int16_t signal, void *buf, uint16_t buf_len, uint16_t *len);
+
+/*---------------------------------------------*/
+/* Event post (owning shard dispatcher에서 비동기 처리) */
+int em_event_post(em_group_name_type *eventgroup, int16_t signal, em_event_arg_type *event);
+
+/*---------------------------------------------*/
+/* Shard dispatcher */
+int em_shard_start(uint16_t shard_count, const int16_t *cpu_map);
+void em_shard_stop(void);
+int em_group_set_shard(em_group_name_type *eventgroup, int16_t shard);
+void em_shard_rebalance(void);
+
+/*---------------------------------------------*/
+/* ISR / signal handler 에서 post (inline payload만, EM_INLINE_PAYLOAD_SIZE 이하) */
+int em_event_post_from_isr(em_group_name_type *eventgroup, int16_t signal, const void *data, uint16_t len);
+int em_dispatch_isr_events(uint16_t max_events);
+#ifndef PC_SIMULATION
+void em_set_isr_notify_task(void *task);
+#endif
+
+/*---------------------------------------------*/
+/* Host event loop (epoll 등) 연동 */
+int em_get_event_fd(void);
+int em_dispatch_pending(uint16_t max_events, uint32_t budget_us);
+
+/*---------------------------------------------*/
+/* Slow handler detection */
+int em_set_handler_budget(em_group_name_type *eventgroup, int16_t signal, evt_handler_fp handler, uint32_t budget_us);
+int em_get_handler_stats(em_group_name_type *eventgroup, int16_t signal, evt_handler_fp handler, em_handler_stats_type *stats);
+void em_set_slow_handler_callback(em_slow_handler_fp callback);
+
+/*---------------------------------------------*/
+/* Memory footprint, compaction */
+void em_memory_report(em_memory_report_type *report);
+int em_compact(void);
+
 /*---------------------------------------------*/
 /* Event manager initialize */
 void em_initialize(void);
@@ -2,6 +2,11 @@
 #include <stdio.h>
 #include <stdint.h>
 #include <string.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/time.h>
 
 #include "em2.h"
 #ifdef PC_SIMULATION
@@ -25,14 +30,71 @@ void test2_handler(const char *groupname, int16_t signal, em_event_arg_type *msg
     #endif
     EM_IS_MEMFREEREQUIRED(msg);
 }
+uint32_t test3_cnt;
 void test3_handler(const char *groupname, int16_t signal, em_event_arg_type *msg)
 {
     char* msg2 = ((msg)&&(msg->msg))?(char*)msg->msg:"" ;
+    test3_cnt++;
     #ifdef PC_SIMULATION
     printf("test3_handler: %s signal(0x%04x) msg(\"%s\") triggered!\n", groupname, signal, msg2);
     #endif
     EM_IS_MEMFREEREQUIRED(msg);    
 }
+/* EM_PAYLOAD_REFCOUNT: payload 보관 후 나중에 release */
+em_event_arg_type kept_arg;
+void keep_handler(const char *groupname, int16_t signal, em_event_arg_type *msg)
+{
+    #ifdef PC_SIMULATION
+    printf("keep_handler: %s signal(0x%04x) msg(\"%s\") retained\n", groupname, signal, (msg && msg->msg) ? (char*)msg->msg : "");
+    #endif
+    if(msg) {
+        kept_arg = *msg;
+        em_event_arg_retain(&kept_arg);
+    }
+}
+/* SIGALRM post test */
+em_group_name_type *isr_event_group;
+volatile sig_atomic_t isr_posted, isr_dropped;
+uint32_t isr_seq, isr_received, isr_order_error;
+void isr_sigalrm(int signo)
+{
+    uint32_t seq = isr_seq;
+    (void)signo;
+    /* signal handler에서 em_event_post_from_isr()만 사용 */
+    if(em_event_post_from_isr(isr_event_group, 5, &seq, sizeof(seq)) == 0) {
+        isr_seq++;
+        isr_posted++;
+    }
+    else {
+        isr_dropped++;
+    }
+}
+void isr_count_handler(const char *groupname, int16_t signal, em_event_arg_type *msg)
+{
+    uint32_t seq;
+    (void)groupname;
+    (void)signal;
+    if(msg && msg->msg && (msg->len == sizeof(seq))) {
+        memcpy(&seq, msg->msg, sizeof(seq));
+        if(seq != isr_received) {
+            isr_order_error++;
+        }
+    }
+    isr_received++;
+}
+void slow_handler(const char *groupname, int16_t signal, em_event_arg_type *msg)
+{
+    char* msg2 = ((msg)&&(msg->msg))?(char*)msg->msg:"" ;
+    usleep(20000);
+    #ifdef PC_SIMULATION
+    printf("slow_handler: %s signal(0x%04x) msg(\"%s\") triggered!\n", groupname, signal, msg2);
+    #endif
+    EM_IS_MEMFREEREQUIRED(msg);
+}
+void slow_handler_report(const char *groupname, int16_t signal, evt_handler_fp handler, uint32_t elapsed_us)
+{
+    printf("slow handler(%p) %s signal(0x%04x) %u us: moved to executor lane\n", handler, groupname, signal, elapsed_us);
+}
 
 
 /*
@@ -41,6 +103,7 @@ void test3_handler(const char *groupname, int16_t signal, em_event_arg_type *msg
        handler에서 signal | 0x8000 해서 Q로 전송 하고
        statemachine에서는 signal | 0x8000 인지 확인
        test.c 참조
+       em_on_event_mailbox() 사용 시 event manager가 signal | 0x8000 해서 mailbox로 전송
 */
 void main()
 {    
@@ -187,4 +250,318 @@ void main()
     printf("\nTrigger AUDIO_EVENT_01 with const event argument\n");
     em_event_trigger(&audio_event_group, AUDIO_EVENT_01, &arg1);
     free(arg1.msg);
+
+
+    /* 
+        3. Per-group attribute test (hash lookup, refcount payload)
+    */
+    printf("\nPer-group attribute test-------------------------------\n");
+    em_group_name_type net_event_group = 
+    {
+        .name = "NET_EVENTS",
+        .gid = -1
+    };
+    enum {
+        NET_EVENT_LINK = 0x0010,
+        NET_EVENT_IP   = 0x0200,
+        NET_EVENT_DNS  = 0x7000,
+    };
+    em_group_attr_type net_attr =
+    {
+        .lookup = EM_LOOKUP_HASH,
+        .payload = EM_PAYLOAD_REFCOUNT,
+        .default_handler_free = 0
+    };
+
+    em_events_register_ex(&net_event_group, NET_EVENT_LINK, &net_attr);
+    em_events_register_ex(&net_event_group, NET_EVENT_IP, &net_attr);
+    em_events_register_ex(&net_event_group, NET_EVENT_DNS, &net_attr);
+
+    em_on_event(&net_event_group, NET_EVENT_IP, test2_handler);
+    em_on_event(&net_event_group, NET_EVENT_IP, keep_handler);
+
+    arg1.isconst = 0;
+    arg1.len = 12;
+    arg1.msg = malloc(arg1.len);
+    memset(arg1.msg,0,arg1.len);
+    memcpy(arg1.msg,"192.168.0.1",arg1.len);
+
+    printf("\nTrigger NET_EVENT_IP with event allocated argument\n");
+    em_event_trigger(&net_event_group, NET_EVENT_IP, &arg1);
+    printf("kept payload after trigger: \"%s\"\n", (char*)kept_arg.msg);
+    em_event_arg_release(&kept_arg);
+
+
+    /* 
+        4. Inline payload test
+    */
+    printf("\nInline payload test-------------------------------\n");
+    char large_msg[64];
+
+    /* EM_INLINE_PAYLOAD_SIZE 이하: heap 사용 안함 */
+    em_event_arg_set(&arg1, "INLINE", 7);
+    printf("\nTrigger ETHERNET_EVENT_03 with inline argument\n");
+    em_event_trigger(&ether_event_group, ETHERNET_EVENT_03, &arg1);
+
+    /* EM_INLINE_PAYLOAD_SIZE 초과: 참조 count buffer */
+    memset(large_msg, 0, sizeof(large_msg));
+    memset(large_msg, 'L', sizeof(large_msg) - 1);
+    em_event_arg_set(&arg1, large_msg, sizeof(large_msg));
+    printf("\nTrigger AUDIO_EVENT_01 with large argument\n");
+    em_event_trigger(&audio_event_group, AUDIO_EVENT_01, &arg1);
+
+
+    /* 
+        5. Last value cache test
+    */
+    printf("\nLast value cache test-------------------------------\n");
+    char last_buf[32];
+    uint16_t last_len = 0;
+
+    em_event_cache_enable(&ether_event_group, ETHERNET_EVENT_02, sizeof(last_buf) - 1);
+
+    arg1.isconst = 1;
+    arg1.len = 8;
+    arg1.msg = "LINK UP";
+
+    printf("\nTrigger ETHERNET_EVENT_02 with const argument\n");
+    em_event_trigger(&ether_event_group, ETHERNET_EVENT_02, &arg1);
+
+    memset(last_buf, 0, sizeof(last_buf));
+    if(em_get_last(&ether_event_group, ETHERNET_EVENT_02, last_buf, sizeof(last_buf) - 1, &last_len) == 0) {
+        printf("em_get_last: ETHERNET_EVENT_02 len(%d) msg(\"%s\")\n", last_len, last_buf);
+    }
+
+    printf("\nSticky subscribe ETHERNET_EVENT_02\n");
+    em_on_event_ex(&ether_event_group, ETHERNET_EVENT_02, test3_handler, EM_SUBSCRIBE_STICKY);
+
+
+    /* 
+        6. Slow handler detection test
+    */
+    printf("\nSlow handler detection test-------------------------------\n");
+    em_handler_stats_type stats;
+
+    em_set_slow_handler_callback(slow_handler_report);
+    em_on_event(&audio_event_group, AUDIO_EVENT_04, slow_handler);
+    em_on_event(&audio_event_group, AUDIO_EVENT_04, test2_handler);
+
+    for(int i = 0; i < EM_SLOW_HANDLER_OFFLOAD_COUNT + 1; i++) {
+        printf("\nTrigger AUDIO_EVENT_04 (%d)\n", i);
+        em_event_trigger(&audio_event_group, AUDIO_EVENT_04, NULL);
+    }
+    em_get_handler_stats(&audio_event_group, AUDIO_EVENT_04, slow_handler, &stats);
+    printf("slow_handler: call(%u) overrun(%u) max(%u us) offloaded(%d)\n",
+           stats.call_cnt, stats.overrun_cnt, stats.max_us, stats.offloaded);
+
+
+    /* 
+        7. Shard dispatcher test
+    */
+    printf("\nShard dispatcher test-------------------------------\n");
+
+    em_shard_start(2, NULL);
+    em_group_set_shard(&ether_event_group, 0);
+    em_group_set_shard(&audio_event_group, 1);
+
+    printf("\nPost ETHERNET_EVENT_01, AUDIO_EVENT_01 with argument NULL\n");
+    em_event_post(&ether_event_group, ETHERNET_EVENT_01, NULL);
+    em_event_post(&audio_event_group, AUDIO_EVENT_01, NULL);
+
+    printf("\nPost AUDIO_EVENT_00 with inline argument\n");
+    em_event_arg_set(&arg1, "POSTED INLINE", 14);
+    em_event_post(&audio_event_group, AUDIO_EVENT_00, &arg1);
+
+    /* allocated memory test: msg 소유권은 event manager로 넘어감 */
+    arg1.isconst = 0;
+    arg1.len = 20;
+    arg1.msg = malloc(arg1.len);
+    memset(arg1.msg,0,arg1.len);
+    memcpy(arg1.msg,"POSTED EVENT",strlen("POSTED EVENT") + 1);
+
+    printf("\nPost ETHERNET_EVENT_03 with event allocated argument\n");
+    em_event_post(&ether_event_group, ETHERNET_EVENT_03, &arg1);
+
+    em_shard_rebalance();
+    em_shard_stop();
+
+
+    /* 
+        8. Host event loop (epoll) test
+    */
+    printf("\nHost event loop test-------------------------------\n");
+    struct epoll_event epev = { .events = EPOLLIN };
+    int epfd = epoll_create1(0);
+    int evfd;
+
+    em_group_set_shard(&ether_event_group, EM_SHARD_HOST);
+    evfd = em_get_event_fd();
+    epev.data.fd = evfd;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, evfd, &epev);
+
+    printf("\nPost ETHERNET_EVENT_01, 03, 05\n");
+    em_event_post(&ether_event_group, ETHERNET_EVENT_01, NULL);
+    em_event_post(&ether_event_group, ETHERNET_EVENT_03, NULL);
+    em_event_post(&ether_event_group, ETHERNET_EVENT_05, NULL);
+
+    /* 1번에 2개씩 처리, 남은 event는 eventfd 다시 readable */
+    while(epoll_wait(epfd, &epev, 1, 100) > 0) {
+        printf("\neventfd readable\n");
+        printf("em_dispatch_pending: %d events dispatched\n", em_dispatch_pending(2, 0));
+    }
+    close(epfd);
+
+
+    /* 
+        9. Mailbox test
+    */
+    printf("\nMailbox test-------------------------------\n");
+    static em_mailbox_slot_type mailbox_slot[8];
+    em_mailbox_type mailbox;
+    em_mailbox_item_type mailbox_item[4];
+    uint16_t mailbox_cnt;
+
+    em_mailbox_init(&mailbox, mailbox_slot, 8);
+    em_on_event_mailbox(&audio_event_group, -1, &mailbox);
+    em_on_event_mailbox(&ether_event_group, ETHERNET_EVENT_04, &mailbox);
+
+    em_event_arg_set(&arg1, "MAILBOX", 8);
+    printf("\nTrigger AUDIO_EVENT_02, ETHERNET_EVENT_04\n");
+    em_event_trigger(&audio_event_group, AUDIO_EVENT_02, &arg1);
+    em_event_trigger(&ether_event_group, ETHERNET_EVENT_04, NULL);
+
+    /* task에서 batch로 처리 */
+    while((mailbox_cnt = em_mailbox_drain(&mailbox, mailbox_item, 4)) > 0) {
+        for(int i = 0; i < mailbox_cnt; i++) {
+            em_event_arg_type *marg = mailbox_item[i].hasarg ? &mailbox_item[i].arg : NULL;
+            printf("mailbox: %s signal(0x%04x) global(%d) msg(\"%s\")\n", mailbox_item[i].groupname,
+                   mailbox_item[i].signal, EM_IS_GLOBAL_SIGNAL(mailbox_item[i].signal),
+                   (marg && marg->msg) ? (char*)marg->msg : "");
+            em_event_arg_release(marg);
+        }
+    }
+
+
+    /* 
+        10. ISR(SIGALRM) post test
+    */
+    printf("\nISR(SIGALRM) post test-------------------------------\n");
+    struct sigaction sa;
+    struct itimerval timer = { .it_interval = { 0, 100 }, .it_value = { 0, 100 } };
+    struct itimerval timer_off = { 0 };
+    int stdout_fd, null_fd;
+    uint32_t load_cnt = 0;
+
+    isr_event_group = &ether_event_group;
+    em_on_event(&ether_event_group, ETHERNET_EVENT_05, isr_count_handler);
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = isr_sigalrm;
+    sa.sa_flags = SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGALRM, &sa, NULL);
+
+    /* load 중 handler 출력은 버림 */
+    fflush(stdout);
+    stdout_fd = dup(STDOUT_FILENO);
+    null_fd = open("/dev/null", O_WRONLY);
+    dup2(null_fd, STDOUT_FILENO);
+
+    setitimer(ITIMER_REAL, &timer, NULL);
+    while(isr_posted + isr_dropped < 500) {
+        /* load: inline trigger 와 ISR event 처리를 같은 thread에서 */
+        em_event_arg_set(&arg1, "LOAD", 5);
+        em_event_trigger(&ether_event_group, ETHERNET_EVENT_01, &arg1);
+        em_dispatch_isr_events(8);
+        load_cnt++;
+    }
+    setitimer(ITIMER_REAL, &timer_off, NULL);
+    em_dispatch_isr_events(0);
+
+    fflush(stdout);
+    dup2(stdout_fd, STDOUT_FILENO);
+    close(stdout_fd);
+    close(null_fd);
+
+    printf("load(%u) posted(%d) dropped(%d) received(%u) order error(%u): %s\n",
+           load_cnt, (int)isr_posted, (int)isr_dropped, isr_received, isr_order_error,
+           ((isr_received == (uint32_t)isr_posted) && (isr_order_error == 0)) ? "PASS" : "FAIL");
+
+
+    /* 
+        11. Group hierarchy test
+    */
+    printf("\nGroup hierarchy test-------------------------------\n");
+    em_group_name_type system_event_group = 
+    {
+        .name = "SYSTEM_EVENTS",
+        .gid = -1
+    };
+
+    em_events_register(&system_event_group, 1);
+    em_group_set_parent(&net_event_group, &system_event_group);
+    em_group_set_parent(&audio_event_group, &system_event_group);
+    /* parent group 전체 구독 -> child group event 수신
+       group_handler는 AUDIO_EVENTS에도 구독 되어 있으므로 AUDIO event에는 1번만 호출 */
+    em_on_event(&system_event_group, -1, group_handler);
+    em_on_event(&system_event_group, -1, test3_handler);
+
+    printf("\nTrigger NET_EVENT_LINK, AUDIO_EVENT_03\n");
+    em_event_trigger(&net_event_group, NET_EVENT_LINK, NULL);
+    em_event_arg_set(&arg1, "CHILD", 6);
+    em_event_trigger(&audio_event_group, AUDIO_EVENT_03, &arg1);
+
+    printf("\nSet SYSTEM_EVENTS parent to NET_EVENTS: %s\n",
+           em_group_set_parent(&system_event_group, &net_event_group) < 0 ? "rejected" : "accepted");
+
+    em_group_set_parent(&audio_event_group, NULL);
+    printf("\nTrigger AUDIO_EVENT_03 after detach\n");
+    em_event_trigger(&audio_event_group, AUDIO_EVENT_03, &arg1);
+
+
+    /* 
+        12. Memory report, compaction test
+    */
+    printf("\nMemory report, compaction test-------------------------------\n");
+    em_memory_report_type mem_report;
+
+    em_memory_report(NULL);
+    printf("\nem_compact: %s\n", em_compact() < 0 ? "FAIL" : "OK");
+    em_memory_report(&mem_report);
+
+    printf("\nTrigger NET_EVENT_IP, AUDIO_EVENT_02 after compaction\n");
+    em_event_arg_set(&arg1, "COMPACT", 8);
+    em_event_trigger(&net_event_group, NET_EVENT_IP, &arg1);
+    em_event_arg_release(&kept_arg);
+    em_event_trigger(&audio_event_group, AUDIO_EVENT_02, &arg1);
+
+
+    /* 
+        13. Duplicate subscription, bulk subscribe test
+    */
+    printf("\nDuplicate subscription, bulk subscribe test-------------------------------\n");
+    em_subscription_type subs[] =
+    {
+        { &net_event_group,   NET_EVENT_LINK, test2_handler, 0 },
+        { &net_event_group,   NET_EVENT_DNS,  test2_handler, 0 },
+        { &net_event_group,   NET_EVENT_DNS,  test3_handler, 0 },
+        { &net_event_group,   NET_EVENT_DNS,  test3_handler, 0 },                      /* reject */
+        { &audio_event_group, AUDIO_EVENT_05, test3_handler, 0 },
+        { &audio_event_group, AUDIO_EVENT_05, test3_handler, EM_SUBSCRIBE_REFCOUNT },  /* refcount */
+    };
+
+    /* ETHERNET_EVENT_01 test2_handler는 1번에서 이미 구독 */
+    em_on_event(&ether_event_group, ETHERNET_EVENT_01, test2_handler);
+    em_on_event_ex(&ether_event_group, ETHERNET_EVENT_01, test2_handler, EM_SUBSCRIBE_REFCOUNT);
+    em_on_events_bulk(subs, sizeof(subs) / sizeof(subs[0]));
+
+    printf("\nTrigger ETHERNET_EVENT_01, NET_EVENT_DNS, AUDIO_EVENT_05 (handler는 1번씩 호출)\n");
+    em_event_trigger(&ether_event_group, ETHERNET_EVENT_01, NULL);
+    /* test3_handler: NET_EVENT_DNS 구독 + parent(SYSTEM_EVENTS) 전체 구독 -> 1번만 호출 */
+    test3_cnt = 0;
+    em_event_trigger(&net_event_group, NET_EVENT_DNS, NULL);
+    printf("NET_EVENT_DNS test3_handler called(%u): %s\n", test3_cnt, (test3_cnt == 1) ? "PASS" : "FAIL");
+    test3_cnt = 0;
+    em_event_trigger(&audio_event_group, AUDIO_EVENT_05, NULL);
+    printf("AUDIO_EVENT_05 test3_handler called(%u): %s\n", test3_cnt, (test3_cnt == 1) ? "PASS" : "FAIL");
 }